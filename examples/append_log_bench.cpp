@@ -0,0 +1,77 @@
+#include <futures/EventExecutor.h>
+#include <futures/detail/LoopFn.h>
+#include <futures/io/AppendLog.h>
+#include <chrono>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace futures;
+
+// `writers' tasks each append `count' records of `size' bytes and wait for
+// every record to be durable before the next one. "naive" issues a write
+// followed by an fdatasync per record, "group" goes through AppendLog
+// which shares one pwritev + fdatasync among all records queued meanwhile.
+
+using Clock = std::chrono::steady_clock;
+using Appender = std::function<BoxedFuture<Unit>()>;
+
+static void run(const char *name, EventExecutor &loop, Appender append,
+    size_t writers, size_t count) {
+  size_t done = 0;
+  for (size_t i = 0; i < writers; ++i) {
+    loop.spawn(makeLoop(size_t(0), [&] (size_t n) {
+      return append()
+        >> [&, n] (Unit) {
+          done++;
+          if (n + 1 >= count)
+            return makeOk(makeBreak<Unit, size_t>(unit));
+          return makeOk(makeContinue<Unit, size_t>(n + 1));
+        };
+    }));
+  }
+  auto start = Clock::now();
+  loop.run();
+  double secs = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << name << ": " << done << " records, " << size_t(done / secs)
+    << " records/s";
+}
+
+int main(int argc, char *argv[])
+{
+  size_t writers = argc > 1 ? atoi(argv[1]) : 64;
+  size_t count = argc > 2 ? atoi(argv[2]) : 50;
+  size_t size = argc > 3 ? atoi(argv[3]) : 128;
+  double latency = argc > 4 ? atof(argv[4]) : 0.0;
+  const char *dir = argc > 5 ? argv[5] : ".";
+
+  std::string path = std::string(dir) + "/futures_journal_"
+    + std::to_string(getpid());
+  std::string record(size, 'x');
+
+  for (bool group : {false, true}) {
+    EventExecutor loop;
+    auto file = std::make_shared<io::AsyncFile>();
+    // AppendLog writes at explicit offsets, naive relies on O_APPEND
+    file->openSync(path, O_RDWR | O_CREAT | O_TRUNC | (group ? 0 : O_APPEND));
+    if (!group) {
+      run("naive", loop, [&] () {
+        return (file->write(folly::IOBuf::copyBuffer(record))
+          >> [file] (ssize_t n) { return file->fsync(true); }).boxed();
+      }, writers, count);
+      std::cout << std::endl;
+    } else {
+      io::AppendLog::Options opts;
+      opts.max_latency = latency;
+      auto log = std::make_shared<io::AppendLog>(&loop, file, opts);
+      run("group", loop, [&] () {
+        return (log->append(folly::IOBuf::copyBuffer(record))
+          | [] (off_t off) { return unit; }).boxed();
+      }, writers, count);
+      std::cout << ", " << log->getCommits() << " commits" << std::endl;
+    }
+    file->closeSync();
+  }
+  ::unlink(path.c_str());
+  return 0;
+}
@@ -7,6 +7,7 @@
 #include <futures/io/Signal.h>
 #include <futures/io/AsyncSocket.h>
 #include <futures/io/AsyncServerSocket.h>
+#include <futures/io/Proxy.h>
 #include <futures/dns/ResolverFuture.h>
 #include <thread>
 #include <iostream>
@@ -255,8 +256,13 @@ static BoxedFuture<folly::Unit> process(EventExecutor *ev,
   .then([state] (Try<Unit> err) {
       if (err.hasException<UpgradeException>()) {
         FUTURES_DLOG(INFO) << "Upgrade";
-        EventExecutor::current()->spawn(forwardResponse(state, true));
-        return forwardResponse(state).boxed();
+        // raw tcp from here on, relayed without copying where possible
+        return (io::proxy(EventExecutor::current(), state->inbound_, state->outbound_)
+          >> [] (io::ProxyStats stats) {
+            FUTURES_DLOG(INFO) << "Tunnel closed, up: " << stats.forward
+                << ", down: " << stats.backward << ", spliced: " << stats.spliced;
+            return makeOk();
+          }).boxed();
       }
       if (err.hasException())
         FUTURES_LOG(ERROR) << err.exception().what();
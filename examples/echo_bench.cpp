@@ -0,0 +1,104 @@
+#include <futures/EventExecutor.h>
+#include <futures/EpollReactor.h>
+#include <futures/Timer.h>
+#include <futures/io/AsyncServerSocket.h>
+#include <futures/io/AsyncSocket.h>
+#include <chrono>
+#include <iostream>
+
+using namespace futures;
+
+// Echo round trips over loopback with the sockets on libev and then on
+// the native epoll reactor. Server and `conns' clients share one loop;
+// each client keeps one `size' byte message in flight for `secs' seconds.
+
+struct Stats {
+  size_t round_trips = 0;
+  bool stopped = false;
+};
+
+static void serve(io::AsyncServerSocket::Ptr server) {
+  EventExecutor::current()->spawn(server->accept()
+    .forEach2([] (tcp::Socket sock, folly::SocketAddress peer) {
+      auto ev = EventExecutor::current();
+      auto s = std::make_shared<io::SocketChannel>(ev, std::move(sock), peer);
+      ev->spawn(s->readStream()
+        .forEach([s] (std::unique_ptr<folly::IOBuf> buf) {
+          EventExecutor::current()->spawn(s->write(std::move(buf))
+            | [] (ssize_t n) { return unit; });
+        }));
+    }));
+}
+
+static void startClient(const folly::SocketAddress &addr, size_t size,
+    Stats *stats) {
+  auto ev = EventExecutor::current();
+  ev->spawn(io::SocketChannel::connect(ev, addr)
+    >> [size, stats] (io::SocketChannel::Ptr sock) {
+      auto payload = std::make_shared<std::string>(size, 'x');
+      auto remain = std::make_shared<size_t>(size);
+      EventExecutor::current()->spawn(
+          sock->write(folly::IOBuf::copyBuffer(*payload))
+          | [] (ssize_t n) { return unit; });
+      return sock->readStream()
+        .forEach([=] (std::unique_ptr<folly::IOBuf> buf) {
+          *remain -= std::min(*remain, buf->computeChainDataLength());
+          if (*remain || stats->stopped)
+            return;
+          stats->round_trips++;
+          *remain = size;
+          EventExecutor::current()->spawn(
+              sock->write(folly::IOBuf::copyBuffer(*payload))
+              | [] (ssize_t n) { return unit; });
+        });
+    });
+}
+
+static void measure(bool epoll, const folly::SocketAddress &addr,
+    size_t conns, size_t size, double secs) {
+  EventExecutor loop;
+  EpollReactor *reactor = nullptr;
+  if (epoll) {
+    reactor = new EpollReactor(&loop);
+    loop.setReactor(std::unique_ptr<Reactor>(reactor));
+  }
+  Stats stats;
+  auto server = std::make_shared<io::AsyncServerSocket>(&loop, addr);
+  loop.spawn(makeLazy([&] {
+    serve(server);
+    for (size_t i = 0; i < conns; ++i)
+      startClient(addr, size, &stats);
+    return unit;
+  }));
+  loop.spawn(delay(&loop, secs)
+    >> [&] (Unit) {
+      stats.stopped = true;
+      EventExecutor::current()->stop();
+      return makeOk();
+    });
+
+  auto start = std::chrono::steady_clock::now();
+  loop.run();
+  double elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+  std::cout << (epoll ? "epoll" : "libev") << ": " << conns << " conns, "
+    << size_t(stats.round_trips / elapsed) << " round trips/s";
+  if (reactor && reactor->getWaits())
+    std::cout << ", " << double(reactor->getEvents()) / reactor->getWaits()
+      << " events per epoll_wait";
+  std::cout << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t conns = argc > 1 ? atoi(argv[1]) : 100;
+  size_t size = argc > 2 ? atoi(argv[2]) : 64;
+  double secs = argc > 3 ? atof(argv[3]) : 5.0;
+  uint16_t port = argc > 4 ? atoi(argv[4]) : 8012;
+
+  folly::SocketAddress addr("127.0.0.1", port);
+  measure(false, addr, conns, size, secs);
+  measure(true, addr, conns, size, secs);
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include <futures/EventExecutor.h>
+#include <futures/detail/LoopFn.h>
+#include <futures/io/AsyncFile.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace futures;
+
+// Random `bs' byte reads from a `size' MiB file with `depth' reads in
+// flight, through AsyncFile::pread once on the blocking thread pool and once
+// on io_uring. The file is usually in the page cache, so this
+// measures the cost per operation rather than the disk.
+
+using Clock = std::chrono::steady_clock;
+using Reader = std::function<BoxedFuture<Unit>(off_t)>;
+
+static void run(const char *name, EventExecutor &loop, Reader reader,
+    size_t count, size_t depth, size_t blocks, size_t bs) {
+  size_t done = 0;
+  for (size_t i = 0; i < depth; ++i) {
+    auto rng = std::make_shared<std::mt19937_64>(i);
+    loop.spawn(makeLoop(size_t(0), [&, rng] (size_t n) {
+      off_t off = ((*rng)() % blocks) * bs;
+      return reader(off)
+        >> [&, n] (Unit) {
+          done++;
+          if (n + 1 >= count / depth)
+            return makeOk(makeBreak<Unit, size_t>(unit));
+          return makeOk(makeContinue<Unit, size_t>(n + 1));
+        };
+    }));
+  }
+  auto start = Clock::now();
+  loop.run();
+  double secs = std::chrono::duration<double>(Clock::now() - start).count();
+  std::cout << name << ": " << done << " reads, " << size_t(done / secs)
+    << " IOPS" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t count = argc > 1 ? atoi(argv[1]) : 200000;
+  size_t depth = argc > 2 ? atoi(argv[2]) : 32;
+  size_t bs = argc > 3 ? atoi(argv[3]) : 4096;
+  size_t size = (argc > 4 ? atoi(argv[4]) : 256) << 20;
+  size_t blocks = size / bs;
+
+  std::string path = "/tmp/futures_iops_" + std::to_string(getpid());
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror("open");
+    return 1;
+  }
+  ::unlink(path.c_str());
+  std::string chunk(1 << 20, 'x');
+  for (size_t n = 0; n < size; n += chunk.size())
+    if (::write(fd, chunk.data(), chunk.size()) < 0) {
+      perror("write");
+      return 1;
+    }
+
+  for (bool uring : {false, true}) {
+    EventExecutor loop;
+    io::FileRing::Ptr ring;
+    if (uring && !(ring = io::FileRing::create(&loop))) {
+      std::cout << "io_uring: unavailable" << std::endl;
+      break;
+    }
+    auto file = std::make_shared<io::AsyncFile>(ring, folly::File(fd));
+    run(uring ? "io_uring" : "pool    ", loop, [&] (off_t off) {
+      return (file->pread(off, bs)
+        | [] (std::unique_ptr<folly::IOBuf> buf) { return unit; }).boxed();
+    }, count, depth, blocks, bs);
+  }
+  ::close(fd);
+  return 0;
+}
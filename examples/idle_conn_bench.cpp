@@ -0,0 +1,80 @@
+#include <futures/EventExecutor.h>
+#include <futures/Timer.h>
+#include <futures/detail/LoopFn.h>
+#include <futures/codec/LineBasedDecoder.h>
+#include <futures/io/AsyncServerSocket.h>
+#include <futures/io/AsyncSocket.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+
+using namespace futures;
+
+// Measures resident memory per idle connection: every client connects to
+// a line based server running in the same loop and sends a partial line,
+// then stays silent. Each server side reader holds a pending frame.
+
+static size_t residentBytes() {
+  std::ifstream f("/proc/self/statm");
+  size_t pages = 0, resident = 0;
+  f >> pages >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc, char *argv[])
+{
+  size_t conns = argc > 1 ? atoi(argv[1]) : 10000;
+  uint16_t port = argc > 2 ? atoi(argv[2]) : 8012;
+
+  EventExecutor loop(true);
+  folly::SocketAddress addr("127.0.0.1", port);
+  auto server = std::make_shared<io::AsyncServerSocket>(&loop, addr);
+
+  std::vector<io::SocketChannel::Ptr> clients;
+  size_t accepted = 0;
+  size_t written = 0;
+
+  loop.spawn(server->accept()
+    .forEach2([&accepted] (tcp::Socket sock, folly::SocketAddress peer) {
+      auto ev = EventExecutor::current();
+      auto s = std::make_shared<io::SocketChannel>(ev, std::move(sock), peer);
+      accepted++;
+      ev->spawn(io::FramedStream<codec::LineBasedOut>(s,
+            std::make_shared<codec::LineBasedDecoder>())
+        .forEach([s] (codec::LineBasedOut line) {
+        }));
+    }));
+
+  size_t base = residentBytes();
+  for (size_t i = 0; i < conns; ++i) {
+    loop.spawn(io::SocketChannel::connect(&loop, addr)
+      >> [&clients, &written] (io::SocketChannel::Ptr sock) {
+        clients.push_back(sock);
+        return sock->write(folly::IOBuf::copyBuffer("partial", 7))
+          | [&written] (ssize_t n) {
+            written++;
+            return unit;
+          };
+      });
+  }
+
+  loop.spawn(makeLoop(0, [&] (int i) {
+    return delay(EventExecutor::current(), 0.5)
+      >> [&, i] (Unit) {
+        if (accepted < conns || written < conns) {
+          std::cerr << "accepted: " << accepted << ", written: " << written
+            << std::endl;
+          return makeOk(makeContinue<Unit, int>(i + 1));
+        }
+        size_t rss = residentBytes();
+        std::cout << "connections: " << conns << std::endl
+          << "rss delta: " << (rss - base) / 1024 << " KiB" << std::endl
+          << "per connection (client + server): "
+          << (rss - base) / conns << " bytes" << std::endl;
+        EventExecutor::current()->stop();
+        return makeOk(makeBreak<Unit, int>(unit));
+      };
+  }));
+  loop.run();
+  return 0;
+}
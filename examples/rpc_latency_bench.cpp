@@ -0,0 +1,114 @@
+#include <futures/EventExecutor.h>
+#include <futures/detail/LoopFn.h>
+#include <futures/codec/LineBasedDecoder.h>
+#include <futures/codec/StringEncoder.h>
+#include <futures/io/AsyncServerSocket.h>
+#include <futures/io/AsyncSocket.h>
+#include <futures/service/Service.h>
+#include <futures/service/RpcFuture.h>
+#include <futures/service/ClientDispatcher.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+
+using namespace futures;
+
+// Request/response latency of a line based echo service served with
+// makePipelineRpcFuture, over loopback TCP and over AF_UNIX. The server
+// runs in its own thread, the client sends one request at a time.
+
+using Line = std::unique_ptr<folly::IOBuf>;
+using Clock = std::chrono::steady_clock;
+
+class EchoService : public service::Service<Line, std::string> {
+public:
+  BoxedFuture<std::string> operator()(Line req) override {
+    auto s = req->coalesce().toString();
+    s += "\r\n";
+    return makeOk(std::move(s));
+  }
+};
+
+static void serve(io::AsyncServerSocket::Ptr server,
+    std::shared_ptr<EchoService> service) {
+  EventExecutor::current()->spawn(server->accept()
+    .forEach2([service] (tcp::Socket sock, folly::SocketAddress peer) {
+      auto ev = EventExecutor::current();
+      auto s = std::make_shared<io::SocketChannel>(ev, std::move(sock), peer);
+      ev->spawn(service::makePipelineRpcFuture(s,
+          io::FramedStream<Line>(s, std::make_shared<codec::LineBasedDecoder>()),
+          io::FramedSink<std::string>(s, std::make_shared<codec::StringEncoder>()),
+          service)
+        .error([] (folly::exception_wrapper err) {
+        }));
+    }));
+}
+
+static void measure(const char *name, const folly::SocketAddress &addr,
+    size_t count) {
+  using Dispatcher = service::PipelineClientDispatcher<std::string, Line>;
+  EventExecutor loop;
+  auto client = std::make_shared<Dispatcher>();
+  std::vector<double> samples;
+  samples.reserve(count);
+
+  loop.spawn(io::SocketChannel::connect(&loop, addr)
+    >> [&] (io::SocketChannel::Ptr sock) {
+      EventExecutor::current()->spawn(service::makeRpcClientFuture(sock,
+          io::FramedStream<Line>(sock, std::make_shared<codec::LineBasedDecoder>()),
+          io::FramedSink<std::string>(sock, std::make_shared<codec::StringEncoder>()),
+          client));
+      return makeLoop(size_t(0), [&] (size_t i) {
+        auto start = Clock::now();
+        return (*client)(std::string("ping\r\n"))
+          >> [&, i, start] (Line resp) {
+            samples.push_back(std::chrono::duration<double, std::micro>(
+                  Clock::now() - start).count());
+            if (i + 1 == count) {
+              client->close();
+              return makeOk(makeBreak<Unit, size_t>(unit));
+            }
+            return makeOk(makeContinue<Unit, size_t>(i + 1));
+          };
+      });
+    });
+  loop.run();
+
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (auto v : samples) sum += v;
+  std::cout << name << ": " << samples.size() << " requests, avg "
+    << sum / samples.size() << "us, p50 " << samples[samples.size() / 2]
+    << "us, p99 " << samples[samples.size() * 99 / 100] << "us" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t count = argc > 1 ? atoi(argv[1]) : 100000;
+  uint16_t port = argc > 2 ? atoi(argv[2]) : 8012;
+
+  folly::SocketAddress tcp_addr("127.0.0.1", port);
+  folly::SocketAddress unix_addr;
+  unix_addr.setFromPath(std::string("\0futures_rpc_bench_", 19)
+      + std::to_string(getpid()));
+
+  EventExecutor server_loop;
+  auto service = std::make_shared<EchoService>();
+  auto tcp_server = std::make_shared<io::AsyncServerSocket>(&server_loop, tcp_addr);
+  auto unix_server = std::make_shared<io::AsyncServerSocket>(&server_loop, unix_addr);
+  server_loop.spawn(makeLazy([=] {
+    serve(tcp_server, service);
+    serve(unix_server, service);
+    return unit;
+  }));
+  std::thread server([&] { server_loop.run(); });
+
+  measure("tcp ", tcp_addr, count);
+  measure("unix", unix_addr, count);
+
+  server_loop.stop();
+  server.join();
+  return 0;
+}
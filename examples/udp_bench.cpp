@@ -0,0 +1,93 @@
+#include <futures/EventExecutor.h>
+#include <futures/Timer.h>
+#include <futures/detail/LoopFn.h>
+#include <futures/io/AsyncUdpSocket.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace futures;
+
+// Loopback datagram throughput: one thread sends `count' datagrams of
+// `size' bytes in batches through the send sink, another receives them
+// from the datagram stream. With `gso' set the sender passes the datagram
+// size as UDP_SEGMENT size and the receiver turns on UDP_GRO.
+
+int main(int argc, char *argv[])
+{
+  size_t count = argc > 1 ? atoi(argv[1]) : 1000000;
+  size_t size = argc > 2 ? atoi(argv[2]) : 1200;
+  bool gso = argc > 3 ? atoi(argv[3]) : false;
+  uint16_t port = argc > 4 ? atoi(argv[4]) : 8012;
+  const size_t batch = 64;
+
+  folly::SocketAddress addr("127.0.0.1", port);
+  std::atomic<size_t> received(0);
+  std::atomic<size_t> received_bytes(0);
+  std::atomic<bool> sent_all(false);
+
+  EventExecutor rx_loop;
+  auto rx = std::make_shared<io::AsyncUdpSocket>(&rx_loop, addr);
+  if (gso && !rx->setGro(true))
+    std::cerr << "UDP_GRO unsupported" << std::endl;
+
+  rx_loop.spawn(rx->recv()
+    .forEach([&] (io::Datagram d) {
+      received.fetch_add(1, std::memory_order_relaxed);
+      received_bytes.fetch_add(std::get<0>(d)->length(), std::memory_order_relaxed);
+    }));
+  // stop once the sender is done and nothing arrived for a while
+  rx_loop.spawn(makeLoop(size_t(0), [&] (size_t last) {
+    return delay(EventExecutor::current(), 0.2)
+      >> [&, last] (Unit) {
+        size_t now = received.load();
+        if (sent_all.load() && now == last) {
+          EventExecutor::current()->stop();
+          return makeOk(makeBreak<Unit, size_t>(unit));
+        }
+        return makeOk(makeContinue<Unit, size_t>(now));
+      };
+  }));
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread sender([&] {
+    EventExecutor tx_loop;
+    auto tx = std::make_shared<io::AsyncUdpSocket>(&tx_loop,
+        folly::SocketAddress("127.0.0.1", 0));
+    if (gso && !tx->setGso(size))
+      std::cerr << "UDP_SEGMENT unsupported" << std::endl;
+    auto sink = std::make_shared<io::UdpSendSink>(tx->sink());
+    std::string payload(size, 'x');
+
+    tx_loop.spawn(makeLoop(size_t(0), [&, sink] (size_t sent) {
+      size_t n = std::min(batch, count - sent);
+      for (size_t i = 0; i < n; ++i)
+        sink->startSend(std::make_tuple(
+              folly::IOBuf::copyBuffer(payload.data(), payload.size()), addr));
+      return sink->flush()
+        >> [&, sent, n] (Unit) {
+          if (sent + n >= count) {
+            sent_all = true;
+            return makeOk(makeBreak<Unit, size_t>(unit));
+          }
+          return makeOk(makeContinue<Unit, size_t>(sent + n));
+        };
+    }));
+    tx_loop.run();
+  });
+
+  rx_loop.run();
+  sender.join();
+  // the receiver idles for the last 0.2s before stopping
+  double secs = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count() - 0.2;
+
+  std::cout << "sent: " << count << " datagrams of " << size << " bytes"
+    << (gso ? " (GSO/GRO)" : "") << std::endl
+    << "received: " << received << " (" << (count - received) << " lost)"
+    << std::endl
+    << "rate: " << size_t(received / secs) << " datagrams/s, "
+    << (received_bytes / secs / (1 << 20)) << " MiB/s" << std::endl;
+  return 0;
+}
@@ -10,11 +10,19 @@ class IAsyncSink {
 public:
     virtual Try<void> startSend(T&& item) = 0;
     virtual Poll<folly::Unit> pollComplete() = 0;
+    // Not ready while the sink buffers more than it wants to, the task is
+    // woken once more items should be sent. startSend() accepts the item
+    // either way.
+    virtual Poll<folly::Unit> pollReady() {
+        return makePollReady(folly::unit);
+    }
     virtual ~IAsyncSink() = default;
 };
 
 template <typename T>
 class FlushSinkFuture;
+template <typename T>
+class ReadySinkFuture;
 
 template <typename Derived, typename T>
 class AsyncSinkBase : public IAsyncSink<T> {
@@ -31,6 +39,7 @@ public:
     }
 
     FlushSinkFuture<T> flush();
+    ReadySinkFuture<T> ready();
 };
 
 template <typename T>
@@ -48,11 +57,31 @@ private:
     IAsyncSink<T> *sink_;
 };
 
+template <typename T>
+class ReadySinkFuture : public FutureBase<ReadySinkFuture<T>, Unit> {
+public:
+    using Item = Unit;
+    ReadySinkFuture(IAsyncSink<T> *sink)
+        : sink_(sink) {}
+
+    Poll<Item> poll() override {
+        if (!sink_) throw FutureCancelledException();
+        return sink_->pollReady();
+    }
+private:
+    IAsyncSink<T> *sink_;
+};
+
 template <typename Derived, typename T>
 FlushSinkFuture<T> AsyncSinkBase<Derived, T>::flush() {
     return FlushSinkFuture<T>(this);
 }
 
+template <typename Derived, typename T>
+ReadySinkFuture<T> AsyncSinkBase<Derived, T>::ready() {
+    return ReadySinkFuture<T>(this);
+}
+
 #if 0
 template <typename Sink>
 class SendSink : public FutureBase<SendSink<Sink>, Sink> {
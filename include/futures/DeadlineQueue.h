@@ -0,0 +1,120 @@
+#pragma once
+
+#include <futures/EventLoop.h>
+#include <boost/intrusive/set.hpp>
+
+namespace futures {
+
+// Deadlines of many long-lived objects (e.g. connection timeouts) on a
+// single ev::timer, see EventExecutor::getDeadlines().
+//
+// An entry is filed under the deadline it had when scheduled. Pushing the
+// deadline later, which is what activity on a connection does, only
+// updates a field: the entry is re-filed under its current deadline when
+// the old one comes up. Only an earlier deadline is re-filed right away.
+class DeadlineQueue {
+public:
+    class Entry : public boost::intrusive::set_base_hook<
+                  boost::intrusive::link_mode<boost::intrusive::auto_unlink>> {
+    public:
+        virtual ~Entry() {}
+
+        // called from the loop once the deadline passed, the entry is
+        // disarmed and may be rescheduled
+        virtual void onDeadline() = 0;
+
+        bool isArmed() const { return deadline_ > 0; }
+        double getDeadline() const { return deadline_; }
+
+    private:
+        friend class DeadlineQueue;
+        // 0 when disarmed
+        double deadline_ = 0;
+        // key in the queue, may be earlier than deadline_
+        double filed_ = 0;
+    };
+
+    explicit DeadlineQueue(ev::loop_ref loop)
+        : loop_(loop), timer_(loop) {
+        timer_.set<DeadlineQueue, &DeadlineQueue::onTimer>(this);
+    }
+
+    DeadlineQueue(const DeadlineQueue&) = delete;
+    DeadlineQueue& operator=(const DeadlineQueue&) = delete;
+
+    ~DeadlineQueue() {
+        timer_.stop();
+        entries_.clear();
+    }
+
+    // (re)arm `e' at absolute loop time `deadline'
+    void schedule(Entry *e, double deadline) {
+        e->deadline_ = deadline;
+        if (e->is_linked()) {
+            if (deadline >= e->filed_)
+                return;
+            e->unlink();
+        }
+        file(e, deadline);
+    }
+
+    // a cancelled entry stays filed until its old deadline comes up
+    void cancel(Entry *e) {
+        e->deadline_ = 0;
+    }
+
+    double now() { return loop_.now(); }
+
+    size_t size() const { return entries_.size(); }
+
+private:
+    struct FiledLess {
+        bool operator()(const Entry &a, const Entry &b) const {
+            return a.filed_ < b.filed_;
+        }
+    };
+    using EntrySet = boost::intrusive::multiset<Entry,
+          boost::intrusive::compare<FiledLess>,
+          boost::intrusive::constant_time_size<false>>;
+
+    ev::loop_ref loop_;
+    ev::timer timer_;
+    EntrySet entries_;
+    // when the timer fires, valid while it is active
+    double armed_ = 0;
+
+    void file(Entry *e, double at) {
+        e->filed_ = at;
+        entries_.insert(*e);
+        if (&*entries_.begin() == e && (!timer_.is_active() || at < armed_))
+            arm(at);
+    }
+
+    void arm(double at) {
+        timer_.stop();
+        armed_ = at;
+        timer_.start(std::max(0.0, at - loop_.now()));
+    }
+
+    void onTimer(ev::timer &w, int revents) {
+        double now = loop_.now();
+        // entries may be rescheduled or destroyed by the callbacks, so
+        // always restart from the earliest one
+        while (!entries_.empty() && entries_.begin()->filed_ <= now) {
+            Entry *e = &*entries_.begin();
+            entries_.erase(entries_.begin());
+            if (!e->isArmed())
+                continue;
+            if (e->deadline_ > now) {
+                file(e, e->deadline_);
+                continue;
+            }
+            e->deadline_ = 0;
+            e->onDeadline();
+        }
+        if (!entries_.empty() && !timer_.is_active())
+            arm(entries_.begin()->filed_);
+    }
+};
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <futures/Reactor.h>
+#include <futures/EventExecutor.h>
+#include <unordered_map>
+#include <vector>
+
+namespace futures {
+
+// Native epoll reactor for io::FdWatcher, set it with
+// EventExecutor::setReactor() before creating sockets on the executor.
+//
+// Each fd is registered once, edge-triggered for both directions, and
+// never modified while the watchers on it start and stop. The epoll fd
+// itself is watched by libev, so timers and the other watchers keep
+// working; every wakeup drains up to kMaxEvents ready fds with a single
+// epoll_wait. A watcher that is still ready after its callback (it did
+// not see EAGAIN) is called again after the next poll.
+class EpollReactor : public Reactor {
+public:
+    static const int kMaxEvents = 256;
+
+    explicit EpollReactor(EventExecutor *ev);
+    ~EpollReactor();
+
+    void attach(io::FdWatcher *w) override;
+    void detach(io::FdWatcher *w) override;
+    void update(io::FdWatcher *w) override;
+    void clearReady(io::FdWatcher *w) override;
+
+    // number of epoll_wait calls and events dispatched from them
+    uint64_t getWaits() const { return waits_; }
+    uint64_t getEvents() const { return events_; }
+
+private:
+    struct Registration {
+        int fd;
+        int ready = 0;
+        bool hup = false;
+        bool queued = false;
+        // usually one read and one write watcher
+        std::vector<io::FdWatcher*> watchers;
+    };
+
+    int epfd_;
+    ev::io io_;
+    ev::check check_;
+    ev::idle idle_;
+    std::unordered_map<int, std::unique_ptr<Registration>> regs_;
+    // fds of queued registrations, a stale entry is skipped
+    std::vector<int> pending_;
+    std::vector<int> running_;
+    uint64_t waits_ = 0;
+    uint64_t events_ = 0;
+
+    Registration *lookup(int fd, Registration *r) {
+        auto it = regs_.find(fd);
+        return it != regs_.end() && it->second.get() == r ? r : nullptr;
+    }
+    void dispatch(Registration *r);
+    void enqueue(Registration *r);
+    void runPending();
+    void onEpoll(ev::io &w, int revents);
+    void onCheck(ev::check &w, int revents);
+    void onIdle(ev::idle &w, int revents) {}
+};
+
+}
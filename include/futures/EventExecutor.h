@@ -4,6 +4,9 @@
 #include <futures/Executor.h>
 #include <futures/EventLoop.h>
 #include <futures/Future.h>
+#include <futures/Reactor.h>
+#include <futures/DeadlineQueue.h>
+#include <futures/MemoryBudget.h>
 
 namespace futures {
 
@@ -72,6 +75,9 @@ public:
                 run->run();
                 delete run;
             }
+            // callbacks may wake up more tasks
+            if (runLoopCallbacks())
+                continue;
             if (!getRunning() && (!always_blocks || wait_stop_)) {
                 FUTURES_DLOG(INFO) << "no pending tasks";
                 break;
@@ -113,6 +119,51 @@ public:
     double getNow() {
         return getLoop().now();
     }
+
+    static const size_t kReadBufferSize = 64 * 1024;
+
+    // Scratch buffer shared by all channels on this executor, a channel
+    // reads into it and hands over only the bytes received. Only valid
+    // until control returns to the loop, grows to at least `size'.
+    std::pair<void*, size_t> getReadBuffer(size_t size = 0) {
+        if (!read_buf_ || read_buf_size_ < size) {
+            read_buf_size_ = std::max(read_buf_size_, size);
+            read_buf_.reset(new char[read_buf_size_]);
+        }
+        return std::make_pair(static_cast<void*>(read_buf_.get()),
+                read_buf_size_);
+    }
+
+    // run the callback once the current loop iteration has drained its
+    // run queue, scheduling an already scheduled callback is a noop
+    void runBeforePoll(LoopCallback *cb) {
+        if (!cb->isLoopCallbackScheduled())
+            loop_callbacks_.push_back(*cb);
+    }
+
+    // Readiness source of the sockets created on this executor afterwards,
+    // nullptr (the default) leaves them on libev.
+    void setReactor(std::unique_ptr<Reactor> reactor) {
+        reactor_ = std::move(reactor);
+    }
+
+    Reactor *getReactor() {
+        return reactor_.get();
+    }
+
+    // Shared by the timeouts of all channels on this executor
+    DeadlineQueue &getDeadlines() {
+        if (!deadlines_)
+            deadlines_.reset(new DeadlineQueue(getLoop()));
+        return *deadlines_;
+    }
+
+    // Bytes buffered by the channels on this executor
+    MemoryBudget &getMemoryBudget() {
+        if (!memory_)
+            memory_.reset(new MemoryBudget(this));
+        return *memory_;
+    }
 private:
     std::unique_ptr<ev::dynamic_loop> dyn_loop_;
     EventWatcherBase::EventList pendings_;
@@ -120,8 +171,29 @@ private:
     boost::intrusive::list<Runnable> foreign_q_;
     std::atomic_bool wait_stop_{false};
 
+    LoopCallback::CallbackList loop_callbacks_;
+    std::unique_ptr<char[]> read_buf_;
+    size_t read_buf_size_ = kReadBufferSize;
+
     std::mutex mu_;
     ev::async signaler_;
+    // destroyed before the loop it watches
+    std::unique_ptr<Reactor> reactor_;
+    std::unique_ptr<DeadlineQueue> deadlines_;
+    std::unique_ptr<MemoryBudget> memory_;
+
+    bool runLoopCallbacks() {
+        if (loop_callbacks_.empty())
+            return false;
+        LoopCallback::CallbackList cbs;
+        cbs.swap(loop_callbacks_);
+        while (!cbs.empty()) {
+            auto &cb = cbs.front();
+            cbs.pop_front();
+            cb.runLoopCallback();
+        }
+        return !q_.empty();
+    }
 
     void merge_queue() {
         std::lock_guard<std::mutex> _g(mu_);
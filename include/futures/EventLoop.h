@@ -25,4 +25,32 @@ public:
     virtual ~EventWatcherBase() = default;
 };
 
+// Callback invoked once at the end of a loop iteration, after the run
+// queue drains and before the executor blocks for I/O events.
+class LoopCallback
+{
+public:
+    typedef boost::intrusive::list_member_hook<
+        boost::intrusive::link_mode<boost::intrusive::auto_unlink>> Hook;
+    Hook loop_hook_;
+
+    typedef boost::intrusive::member_hook<LoopCallback, Hook,
+            &LoopCallback::loop_hook_> MemberHookOption;
+
+    typedef boost::intrusive::list<LoopCallback, MemberHookOption,
+            boost::intrusive::constant_time_size<false>> CallbackList;
+
+    virtual void runLoopCallback() = 0;
+
+    bool isLoopCallbackScheduled() const {
+        return loop_hook_.is_linked();
+    }
+
+    void cancelLoopCallback() {
+        loop_hook_.unlink();
+    }
+
+    virtual ~LoopCallback() = default;
+};
+
 }
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <futures/EventLoop.h>
+#include <futures/DeadlineQueue.h>
+#include <boost/intrusive/list.hpp>
+#include <atomic>
+#include <sys/types.h>
+
+namespace futures {
+
+class EventExecutor;
+
+// Bytes buffered by the channels of one executor: data read but not
+// consumed yet, encoded frames and writes the kernel has not taken. See
+// EventExecutor::getMemoryBudget(), the usage of all executors is also
+// summed up process-wide.
+//
+// Once the executor's usage reaches its high watermark, or the process
+// reaches the global one, the channel holding the most bytes stops
+// reading. While the usage keeps growing one more channel is paused per
+// loop iteration. Paused channels resume together once the usage is back
+// at the low watermarks. Both are 0, unlimited, by default. Other
+// executors draining the global usage cause no events here, so it is
+// checked every kRecheckInterval while channels are paused.
+class MemoryBudget : public LoopCallback {
+public:
+    class Account : public boost::intrusive::list_base_hook<
+                    boost::intrusive::link_mode<boost::intrusive::auto_unlink>> {
+    public:
+        virtual ~Account();
+
+        size_t getMemoryUsage() const { return usage_; }
+        bool isReadPaused() const { return paused_; }
+
+    protected:
+        virtual void pauseReading() = 0;
+        virtual void resumeReading() = 0;
+
+    private:
+        friend class MemoryBudget;
+        MemoryBudget *budget_ = nullptr;
+        size_t usage_ = 0;
+        bool paused_ = false;
+    };
+
+    explicit MemoryBudget(EventExecutor *ev) : ev_(ev), recheck_(this) {}
+    ~MemoryBudget();
+
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    void setWatermarks(size_t low, size_t high);
+    size_t getHighWatermark() const { return high_; }
+    size_t getLowWatermark() const { return low_; }
+
+    // bytes `a' started (delta > 0) or stopped holding
+    void charge(Account *a, ssize_t delta);
+
+    size_t getUsage() const { return usage_; }
+    size_t getPausedCount() const { return paused_; }
+    // channels paused so far
+    uint64_t getPauses() const { return pauses_; }
+
+    // process-wide, updated in steps of kGlobalGranularity per executor
+    static void setGlobalWatermarks(size_t low, size_t high);
+    static size_t getGlobalUsage();
+
+    static const size_t kGlobalGranularity = 64 * 1024;
+    // seconds
+    static constexpr double kRecheckInterval = 0.05;
+
+    void runLoopCallback() override;
+
+private:
+    using AccountList = boost::intrusive::list<Account,
+          boost::intrusive::constant_time_size<false>>;
+
+    struct Recheck : public DeadlineQueue::Entry {
+        MemoryBudget *budget;
+
+        explicit Recheck(MemoryBudget *budget) : budget(budget) {}
+
+        void onDeadline() override {
+            budget->recheck();
+        }
+    };
+
+    EventExecutor *ev_;
+    // unlinked from the executor's DeadlineQueue once destroyed
+    Recheck recheck_;
+    AccountList accounts_;
+    size_t usage_ = 0;
+    // part of usage_ added to the global usage
+    size_t reported_ = 0;
+    size_t low_ = 0;
+    size_t high_ = 0;
+    size_t paused_ = 0;
+    uint64_t pauses_ = 0;
+
+    bool overHigh() const;
+    bool underLow() const;
+    void detach(Account *a);
+    void report();
+    void resumeAll();
+    void scheduleRecheck();
+    void recheck();
+};
+
+}
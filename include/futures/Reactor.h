@@ -0,0 +1,25 @@
+#pragma once
+
+namespace futures {
+
+namespace io {
+class FdWatcher;
+}
+
+// Readiness source for io::FdWatcher. Without one set on the executor,
+// watchers use libev directly.
+class Reactor {
+public:
+    virtual ~Reactor() = default;
+
+    // the watcher's fd was set, watchers on the same fd share a registration
+    virtual void attach(io::FdWatcher *w) = 0;
+    // before the fd is closed or the watcher destroyed
+    virtual void detach(io::FdWatcher *w) = 0;
+    // the watcher was started or stopped
+    virtual void update(io::FdWatcher *w) = 0;
+    // the fd returned EAGAIN for the watcher's events
+    virtual void clearReady(io::FdWatcher *w) = 0;
+};
+
+}
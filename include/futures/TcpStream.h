@@ -11,6 +11,44 @@ namespace futures {
 
 namespace tcp {
 
+// Options left unset keep the kernel default. The TCP level ones are
+// skipped on AF_UNIX sockets.
+struct SocketOptions {
+    Optional<bool> no_delay;
+    Optional<bool> keep_alive;
+    // seconds idle before the first keepalive probe, between probes, and
+    // unanswered probes before the connection is dropped
+    Optional<int> keep_idle;
+    Optional<int> keep_interval;
+    Optional<int> keep_count;
+    Optional<int> send_buffer;
+    Optional<int> recv_buffer;
+    // bytes of unsent data the socket reports writable below
+    Optional<int> not_sent_lowat;
+    // microseconds to busy poll the device queue on blocking reads
+    Optional<int> busy_poll;
+    // milliseconds transmitted data may stay unacknowledged
+    Optional<int> user_timeout;
+    // IP_TOS, or the IPv6 traffic class
+    Optional<int> tos;
+};
+
+// subset of the kernel's tcp_info
+struct TcpInfo {
+    uint8_t state = 0;
+    uint32_t rtt_us = 0;
+    uint32_t rttvar_us = 0;
+    uint32_t snd_cwnd = 0;
+    uint32_t snd_ssthresh = 0;
+    uint32_t snd_mss = 0;
+    uint32_t rcv_mss = 0;
+    uint32_t unacked = 0;
+    uint32_t lost = 0;
+    // retransmits of the current timeout, and since connect
+    uint32_t retransmits = 0;
+    uint32_t total_retrans = 0;
+};
+
 class Socket {
 public:
     Socket();
@@ -21,16 +59,36 @@ public:
     bool connectIP(const std::string &addr, uint16_t port, std::error_code &ec) ;
     bool connectUnix(const std::string &path, std::error_code &ec) ;
     bool connect(const folly::SocketAddress &addr, std::error_code &ec) ;
+    // applies `opts' before connecting, so buffer sizes take effect
+    // during the handshake
+    bool connect(const folly::SocketAddress &addr,
+            const SocketOptions &opts, std::error_code &ec);
 
     bool is_connected(std::error_code &ec);
 
     void tcpServer(const std::string& bindaddr, uint16_t port,
             int backlog, std::error_code &ec);
 
+    // nonblocking, close-on-exec stream socket of `family'
+    void open(int family, std::error_code &ec);
+    void setOption(int level, int name, int value, std::error_code &ec);
+    void bind(const folly::SocketAddress &addr, std::error_code &ec);
+    void listen(int backlog, std::error_code &ec);
+    folly::SocketAddress getLocalAddress() const;
+    void applyOptions(const SocketOptions &opts, std::error_code &ec);
+    TcpInfo getTcpInfo(std::error_code &ec) const;
+
     void close() noexcept;
     void shutdown(int how, std::error_code &ec) noexcept;
     ssize_t writev(const iovec *vec, size_t veclen, int flags, std::error_code &ec);
     ssize_t recv(void *buf, size_t len, int flags, std::error_code &ec);
+    // scatter read, errors like recv()
+    ssize_t readv(const iovec *vec, size_t veclen, std::error_code &ec);
+    // SCM_RIGHTS on AF_UNIX: `fds' go along with the first byte written,
+    // received ones are appended to `fds' with close-on-exec set
+    ssize_t sendWithFds(const iovec *vec, size_t veclen,
+            const std::vector<int> &fds, std::error_code &ec);
+    ssize_t recvWithFds(void *buf, size_t len, std::vector<int> *fds, std::error_code &ec);
     Socket accept(std::error_code& ec, folly::SocketAddress *peer = nullptr);
 
     Socket(const Socket&) = delete;
@@ -923,6 +923,11 @@ class IOBuf {
       return true;
     }
 
+    // So is a buffer marked with markExternallyShared()
+    if (UNLIKELY(sharedInfo()->externallyShared)) {
+      return true;
+    }
+
     if (LIKELY(!(flags() & kFlagMaybeShared))) {
       return false;
     }
@@ -982,6 +987,26 @@ class IOBuf {
     }
   }
 
+  /**
+   * Mark the buffers of this chain as shared, for good.  isSharedOne() then
+   * returns true for them and every IOBuf sharing them, even once a single
+   * reference is left, so callers never write into them in place.  Meant
+   * for buffers the IOBuf owns but that must not be written, e.g. read-only
+   * memory mappings.
+   */
+  void markExternallyShared();
+
+  /**
+   * Mark the buffer of this IOBuf as shared, see markExternallyShared().
+   * User-owned buffers are always reported as shared already.
+   */
+  void markExternallySharedOne() {
+    SharedInfo* info = sharedInfo();
+    if (info) {
+      info->externallyShared = true;
+    }
+  }
+
   /**
    * Ensure that the memory that IOBufs in this chain refer to will continue to
    * be allocated for as long as the IOBufs of the chain (or any clone()s
@@ -1223,6 +1248,8 @@ class IOBuf {
     FreeFunction freeFn;
     void* userData;
     std::atomic<uint32_t> refcount;
+    // set by markExternallyShared()
+    bool externallyShared{false};
   };
   // Helper structs for use by operator new and delete
   struct HeapPrefix;
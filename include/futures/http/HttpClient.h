@@ -3,9 +3,11 @@
 #include <futures/http/HttpCodec.h>
 #include <futures/io/AsyncSocket.h>
 #include <futures/io/AsyncSSLSocket.h>
+#include <futures/io/HappyEyeballs.h>
 #include <futures/dns/Resolver.h>
 #include <futures/service/RpcFuture.h>
 #include <futures/service/ClientDispatcher.h>
+#include <futures/service/ConnectionPool.h>
 
 namespace futures {
 namespace http {
@@ -15,14 +17,52 @@ struct Url {
     std::string host;
     unsigned short port;
     std::string path;
+    // connect to this AF_UNIX socket (a leading NUL selects the abstract
+    // namespace) instead of resolving host, which is still sent as Host
+    std::string unix_path;
 };
 
 class HttpClient : public std::enable_shared_from_this<HttpClient> {
+    using dispatcher_type = service::PipelineClientDispatcher<http::Request, http::Response>;
 public:
     using HeaderFields = std::unordered_map<std::string, std::string>;
 
+    // A connection of a Pool, closed once the pool drops it
+    class Connection {
+    public:
+        Connection(EventExecutor *ev, io::SocketChannel::Ptr sock);
+        ~Connection();
+
+        BoxedFuture<Response> operator()(http::Request &&req) {
+            return (*client_)(std::move(req));
+        }
+
+        bool good() const { return sock_->good() && !client_->hasClosed(); }
+
+        Connection(const Connection&) = delete;
+        Connection& operator=(const Connection&) = delete;
+    private:
+        io::SocketChannel::Ptr sock_;
+        std::shared_ptr<dispatcher_type> client_;
+    };
+
+    // Connections shared by the clients of one executor, keyed by
+    // "schema://host:port", see poolKey()
+    using Pool = service::ConnectionPool<Connection, std::string>;
+
+    // Connects like a client of its own would, through `resolver' and
+    // with `ctx' for https origins
+    static Pool::Ptr makePool(EventExecutor *ev, dns::AsyncResolver::Ptr resolver,
+            io::SSLContext *ctx = nullptr,
+            const Pool::Options &opts = Pool::Options());
+    static std::string poolKey(const Url &url);
+
     HttpClient(EventExecutor *ev, dns::AsyncResolver::Ptr resolver, const Url &url);
     HttpClient(EventExecutor *ev, io::SSLContext *ctx, dns::AsyncResolver::Ptr resolver, const Url &url);
+    // Each request checks a connection to the origin of `url' out of
+    // `pool', so concurrent requests go over several connections instead
+    // of being pipelined on one. AF_UNIX urls are not supported.
+    HttpClient(EventExecutor *ev, Pool::Ptr pool, const Url &url);
 
     BoxedFuture<Unit> close();
 
@@ -57,7 +97,7 @@ public:
     static Url parseUrl(const std::string &host);
 
     bool isSSL() const { return host_.schema == "https"; }
-    bool good() const { return !closing_ && client_; }
+    bool good() const { return !closing_ && (pool_ || client_); }
 
     void setUserAgent(const std::string &ua) {
         user_agent_ = ua;
@@ -67,11 +107,11 @@ public:
         return user_agent_;
     }
 private:
-    using dispatcher_type = service::PipelineClientDispatcher<http::Request, http::Response>;
     EventExecutor *ev_;
     io::SSLContext *ssl_ctx_ = nullptr;
     dns::AsyncResolver::Ptr resolver_;
     const Url host_;
+    Pool::Ptr pool_;
 
     // settings
     std::string user_agent_{"HttpClientCpp/0.1.0"};
@@ -80,9 +120,15 @@ private:
     io::SocketChannel::Ptr sock_;
     bool closing_ = false;
 
-    BoxedFuture<folly::IPAddress> resolve();
+    static BoxedFuture<dns::ResolverResult> resolve(
+            dns::AsyncResolver::Ptr resolver, const std::string &host);
+    static BoxedFuture<io::SocketChannel::Ptr> connectTo(EventExecutor *ev,
+            io::SSLContext *ctx, dns::AsyncResolver::Ptr resolver, const Url &url);
+    static std::shared_ptr<dispatcher_type> spawnDispatcher(EventExecutor *ev,
+            io::SocketChannel::Ptr sock);
 
     void spawnClient(io::SocketChannel::Ptr sock);
+    BoxedFuture<Response> pooledRequest(http::Request&& req);
     void fillHeaders(HeaderFields &headers);
 
     void resetConnection() {
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <futures/io/AsyncFile.h>
+#include <futures/EventExecutor.h>
+#include <futures/Promise.h>
+#include <deque>
+
+namespace futures {
+namespace io {
+
+// Append-only journal with group commit. Records appended by any number of
+// tasks are written together and made durable with a single fdatasync per
+// batch, append() resolves with the offset of the record once its batch
+// is on disk. One commit is in flight at a time, records arriving
+// meanwhile form the next batch.
+//
+// A failed commit fails its records and every later append(), the tail of
+// the file is then undefined. Only use it from the executor's thread.
+class AppendLog : public std::enable_shared_from_this<AppendLog> {
+public:
+    using Ptr = std::shared_ptr<AppendLog>;
+
+    struct Options {
+        // how long a batch may wait for more records before it is
+        // committed, 0 commits as soon as the previous commit is done
+        double max_latency;
+        // a batch is committed right away once it holds this many records
+        // or bytes
+        size_t max_records;
+        size_t max_bytes;
+
+        Options()
+            : max_latency(0.0), max_records(1024), max_bytes(4 << 20) {
+        }
+    };
+
+    // appends at the current end of `file'
+    AppendLog(EventExecutor *ev, AsyncFile::Ptr file,
+            const Options &opts = Options());
+    ~AppendLog();
+
+    BoxedFuture<off_t> append(std::unique_ptr<folly::IOBuf> record);
+
+    // records not yet durable
+    size_t getPending() const { return pending_.size() + committing_; }
+    // end of the last durable record
+    off_t getDurableOffset() const { return durable_; }
+    // number of batches written and synced
+    uint64_t getCommits() const { return commits_; }
+
+private:
+    struct Entry {
+        std::unique_ptr<folly::IOBuf> buf;
+        Promise<off_t> promise;
+    };
+
+    EventExecutor *ev_;
+    AsyncFile::Ptr file_;
+    Options opts_;
+    ev::timer timer_;
+
+    std::deque<Entry> pending_;
+    size_t pending_bytes_ = 0;
+    // records in the commit in flight
+    size_t committing_ = 0;
+    bool expired_ = false;
+    off_t end_;
+    off_t durable_;
+    uint64_t commits_ = 0;
+    folly::exception_wrapper error_;
+
+    void maybeCommit();
+    void commit();
+    void onTimer(ev::timer &w, int revents);
+};
+
+}
+}
@@ -4,10 +4,15 @@
 #include <futures/Future.h>
 #include <futures/core/IOBuf.h>
 #include <futures/io/WaitHandleBase.h>
+#include <futures/io/FileRing.h>
+#include <futures/Stream.h>
+#include <deque>
 
 namespace futures {
 namespace io {
 
+class FileReadStream;
+
 class AsyncFile : public std::enable_shared_from_this<AsyncFile> {
 public:
     using Ptr = std::shared_ptr<AsyncFile>;
@@ -18,6 +23,12 @@ public:
 
     AsyncFile() {}
 
+    // Asynchronous operations go through `ring' instead of the blocking
+    // thread pool, nullptr keeps the pool. The file must then only be used
+    // from the ring's executor.
+    AsyncFile(FileRing::Ptr ring, folly::File file = folly::File())
+        : file_(std::move(file)), ring_(std::move(ring)) {}
+
     bool isValid() const { return (bool)file_; }
 
     void openSync(const std::string &path, int flags, mode_t mode = 0644);
@@ -27,10 +38,32 @@ public:
     BoxedFuture<buf_ptr> read(size_t count);
     BoxedFuture<buf_ptr> read(buf_ptr);
 
+    // Positional reads leave the file position alone, so any number of them
+    // may be in flight on one file. The result is short at end of file.
+    // Asynchronous reads and writes start when called, not when first
+    // polled, so the ones issued together run concurrently.
+    ssize_t preadSync(void *buf, size_t count, off_t offset);
+    ssize_t preadvSync(const iovec *iov, int iovcnt, off_t offset);
+    BoxedFuture<buf_ptr> pread(off_t offset, size_t count);
+    // fills the tailroom of each buffer in the chain in order, until it is
+    // full or at end of file
+    BoxedFuture<buf_ptr> preadv(off_t offset, buf_ptr bufs);
+
+    // Sequential read from `offset' to the end of file in `chunk' sized
+    // buffers, keeping up to `window' reads in flight. New reads are only
+    // issued as the consumer takes buffers. The stream polls the oldest
+    // read only, the others run because pread() starts them when called.
+    inline FileReadStream readStream(size_t chunk = 64 * 1024,
+            size_t window = 4, off_t offset = 0);
+
     ssize_t writeSync(const void *buf, size_t count);
-    // ssize_t writeIovSync(struct iovec *v);
+    ssize_t writevSync(const iovec *iov, int iovcnt);
+    ssize_t pwritevSync(const iovec *iov, int iovcnt, off_t offset);
 
+    // both write the whole chain, IOV_MAX buffers per writev/pwritev and
+    // continuing after short writes, pwrite() leaves the file position alone
     BoxedFuture<ssize_t> write(buf_ptr buf);
+    BoxedFuture<ssize_t> pwrite(off_t offset, buf_ptr buf);
 
     void fsyncSync(bool data_only = false);
     BoxedFuture<Unit> fsync(bool data_only = false);
@@ -39,9 +72,66 @@ public:
     BoxedFuture<Unit> close();
 
     int fd() const { return file_.fd(); }
+    const FileRing::Ptr &getRing() const { return ring_; }
 private:
     folly::File file_;
+    FileRing::Ptr ring_;
+
+    BoxedFuture<buf_ptr> ringReadv(off_t offset, buf_ptr bufs);
+    BoxedFuture<ssize_t> ringWritev(off_t offset, buf_ptr buf,
+            size_t done, size_t total);
+};
+
+class FileReadStream : public StreamBase<FileReadStream, std::unique_ptr<folly::IOBuf>> {
+public:
+    using Item = std::unique_ptr<folly::IOBuf>;
+
+    FileReadStream(AsyncFile::Ptr file, size_t chunk, size_t window, off_t offset)
+        : file_(std::move(file)), chunk_(std::max<size_t>(chunk, 1)),
+          window_(std::max<size_t>(window, 1)), offset_(offset) {
+#ifdef POSIX_FADV_SEQUENTIAL
+        // larger kernel readahead for the rest of the file
+        ::posix_fadvise(file_->fd(), offset, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    Poll<Optional<Item>> poll() override {
+        while (!eof_ && reads_.size() < window_) {
+            reads_.push_back(file_->pread(offset_, chunk_));
+            offset_ += chunk_;
+        }
+        if (reads_.empty())
+            return makePollReady(Optional<Item>());
+        auto r = reads_.front().poll();
+        if (r.hasException())
+            return Poll<Optional<Item>>(r.exception());
+        if (!r->hasValue())
+            return Poll<Optional<Item>>(not_ready);
+        reads_.pop_front();
+        auto v = folly::moveFromTry(r);
+        auto buf = std::move(v).value();
+        if (buf->length() < chunk_) {
+            // reads past this one can only come back empty
+            eof_ = true;
+            reads_.clear();
+            if (buf->empty())
+                return makePollReady(Optional<Item>());
+        }
+        return makePollReady(Optional<Item>(std::move(buf)));
+    }
+
+private:
+    AsyncFile::Ptr file_;
+    size_t chunk_;
+    size_t window_;
+    off_t offset_;
+    bool eof_ = false;
+    std::deque<BoxedFuture<std::unique_ptr<folly::IOBuf>>> reads_;
 };
 
+FileReadStream AsyncFile::readStream(size_t chunk, size_t window, off_t offset) {
+    return FileReadStream(shared_from_this(), chunk, window, offset);
+}
+
 }
 };
@@ -19,6 +19,14 @@ public:
     void onEvent(ev::io& watcher, int revent);
 
     io::intrusive_ptr<ConnectCompletionToken> doHandshake();
+
+    // records are encrypted into OpenSSL buffers, nothing to gain
+    bool setZeroCopy(bool enable, size_t threshold = kZeroCopyThreshold) override {
+        return !enable;
+    }
+    bool canSendFile() const override {
+        return false;
+    }
     void printPeerCert();
 
     static SSLSockConnectFuture
@@ -41,6 +49,12 @@ private:
     void failHandshake(std::error_code ec);
     void handleConnect();
 
+    bool writable() const override {
+        return SocketChannel::writable()
+            && (ssl_state_ == STATE_ESTABLISHED
+                    || ssl_state_ == STATE_UNENCRYPTED);
+    }
+
     ssize_t performWrite(
             const iovec* vec,
             size_t count,
@@ -49,6 +63,7 @@ private:
             std::error_code &ec) override;
 
     ssize_t performRead(void *buf, size_t bufLen, std::error_code &ec) override;
+    bool canScatterRead() const override { return false; }
 
     int eorAwareSSLWrite(SSL *ssl, const void *buf, int n, bool eor);
     std::error_code interpretSSLError(int rc, int error);
@@ -3,6 +3,7 @@
 #include <futures/TcpStream.h>
 #include <futures/io/WaitHandleBase.h>
 #include <futures/core/SocketAddress.h>
+#include <futures/io/FdWatcher.h>
 #include <deque>
 
 namespace futures {
@@ -10,20 +11,38 @@ namespace io {
 
 class AcceptStream;
 
+struct ServerSocketOptions {
+    // listen queue, the kernel caps it at net.core.somaxconn
+    int backlog = SOMAXCONN;
+    bool reuse_port = false;
+    // IPv6 binds accept IPv4 clients too unless set
+    bool v6_only = false;
+    // TCP_DEFER_ACCEPT: wake up only once data arrived, in seconds
+    int defer_accept = 0;
+    // TCP_FASTOPEN: queue length of pending fastopen requests
+    int fastopen_queue = 0;
+    // accepts per readiness event, and accepted sockets queued in the
+    // stream before accepting pauses; the rest wait in the backlog
+    size_t max_accepts = 64;
+    // applied to every accepted socket
+    tcp::SocketOptions accepted;
+};
+
 class AsyncServerSocket
     : public IOObject,
       public std::enable_shared_from_this<AsyncServerSocket> {
 public:
     using Ptr = std::shared_ptr<AsyncServerSocket>;
 
-    AsyncServerSocket(EventExecutor *ev, const folly::SocketAddress &bind)
-        : IOObject(ev), rio_(ev->getLoop()) {
-        std::error_code ec;
-        socket_.tcpServer(bind.getIPAddress().asV4().str(), bind.getPort(), 32, ec);
-        if (ec) throw IOError("bind", ec);
-        rio_.set<AsyncServerSocket, &AsyncServerSocket::onEvent>(this);
-        rio_.set(socket_.fd(), ev::READ);
-    }
+    AsyncServerSocket(EventExecutor *ev, const folly::SocketAddress &bind,
+            const ServerSocketOptions &opts = ServerSocketOptions());
+
+    // Takes over a socket that is already listening, e.g. inherited across
+    // exec or received from the previous process with
+    // SocketChannel::takeReceivedFds(). Connections waiting in its backlog
+    // are accepted here. Only `accepted' and `max_accepts' of `opts' apply.
+    AsyncServerSocket(EventExecutor *ev, tcp::Socket listener,
+            const ServerSocketOptions &opts = ServerSocketOptions());
 
     struct AcceptCompletionToken : public io::CompletionToken {
         std::error_code ec;
@@ -45,6 +64,7 @@ public:
             }
             switch (getState()) {
             case STARTED:
+                static_cast<AsyncServerSocket*>(getIOObject())->resumeAccept();
                 park();
                 return Poll<Optional<Item>>(not_ready);
             case DONE:
@@ -61,6 +81,10 @@ public:
         void append(Item&& item) {
             sock_.push_back(std::move(item));
         }
+
+        size_t queued() const {
+            return sock_.size();
+        }
     protected:
         ~AcceptCompletionToken() {
             cleanup(CancelReason::UserCancel);
@@ -80,10 +104,20 @@ public:
     }
 
     void forceClose() {
-        rio_.stop();
+        backoff_.stop();
+        // detach before the fd number can be reused
+        rio_.reset();
         socket_.close();
+        closed_ = true;
+    }
+
+    folly::SocketAddress getLocalAddress() const {
+        return socket_.getLocalAddress();
     }
 
+    // for handing the listener to another process
+    int fd() const { return socket_.fd(); }
+
     inline AcceptStream accept();
 
     void onCancel(CancelReason reason) override {
@@ -92,37 +126,18 @@ public:
 
 private:
     tcp::Socket socket_;
-    ev::io rio_;
+    FdWatcher rio_;
+    ev::timer backoff_;
+    ServerSocketOptions opts_;
     bool closed_ = false;
 
-    void onEvent(ev::io& watcher, int revent) {
-        if (revent & ev::READ) {
-            auto &list = getPending(IOObject::OpRead);
-            if (list.empty()) {
-                rio_.stop();
-            } else {
-                folly::SocketAddress addr;
-                std::error_code ec;
-                auto p = static_cast<AcceptCompletionToken*>(&list.front());
-                while (true) {
-                    tcp::Socket s = socket_.accept(ec, &addr);
-                    if (ec) {
-                        p->ec = ec;
-                        p->notifyDone();
-                        forceClose();
-                        break;
-                    } else if (!s.isValid()) {
-                        // would block
-                        break;
-                    } else {
-                        p->append(std::make_tuple(std::move(s), addr));
-                        p->notify();
-                    }
-                }
-            }
-        }
-    }
+    void onEvent(ev::io& watcher, int revent);
+    void onBackoff(ev::timer& watcher, int revent);
 
+    void resumeAccept() {
+        if (!closed_ && !rio_.is_active() && !backoff_.is_active())
+            rio_.start();
+    }
 };
 
 using AcceptItem = std::tuple<tcp::Socket, folly::SocketAddress>;
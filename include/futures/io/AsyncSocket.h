@@ -4,6 +4,9 @@
 #include <futures/io/WaitHandleBase.h>
 #include <futures/core/SocketAddress.h>
 #include <futures/io/Channel.h>
+#include <futures/io/FdWatcher.h>
+#include <futures/io/AsyncFile.h>
+#include <deque>
 
 namespace futures {
 namespace io {
@@ -13,6 +16,7 @@ class WriteFuture;
 class ReadStream;
 
 class SocketChannel : public Channel,
+    public LoopCallback,
     public std::enable_shared_from_this<SocketChannel> {
 protected:
     enum State {
@@ -37,7 +41,7 @@ public:
     using Ptr = std::shared_ptr<SocketChannel>;
 
     SocketChannel(EventExecutor *ev)
-        : Channel(ev), rio_(ev->getLoop()), wio_(ev->getLoop())
+        : Channel(ev), rio_(ev), wio_(ev)
     {
         rio_.set<SocketChannel, &SocketChannel::onEvent>(this);
         wio_.set<SocketChannel, &SocketChannel::onEvent>(this);
@@ -47,7 +51,7 @@ public:
             const folly::SocketAddress& peer = folly::SocketAddress())
         : Channel(ev),
           socket_(std::move(socket)), peer_addr_(peer), s_(CONNECTED),
-          rio_(ev->getLoop()), wio_(ev->getLoop())
+          rio_(ev), wio_(ev)
     {
         assert(socket_.fd() != -1);
 
@@ -57,6 +61,17 @@ public:
         rio_.set(socket_.fd(), ev::READ);
     }
 
+    ~SocketChannel() {
+        for (int fd : received_fds_)
+            ::close(fd);
+        if (!zc_sends_.empty() && socket_.isValid()) {
+            // the held buffers go with the channel, reset the connection
+            // so the kernel stops sending from them
+            struct linger l = {1, 0};
+            ::setsockopt(socket_.fd(), SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+        }
+    }
+
 
     struct ConnectCompletionToken : public io::CompletionToken {
         std::error_code ec;
@@ -112,7 +127,12 @@ public:
             tok->readError(std::make_error_code(std::errc::connection_aborted));
         } else {
             tok->attach(this);
-            rio_.start();
+            if (!read_paused_)
+                rio_.start();
+            if (read_timeout_ > 0) {
+                read_deadline_ = getExecutor()->getNow() + read_timeout_;
+                rearmTimeouts();
+            }
         }
         return tok;
     }
@@ -125,10 +145,20 @@ public:
                 || (shutdown_flags_ & SHUT_WRITE_PENDING)
                 || (shutdown_flags_ & SHUT_WRITE)) {
             tok->writeError(std::make_error_code(std::errc::connection_aborted));
-        } else if (s_ == CONNECTED) {
-            // TODO try send immediately
+        } else {
+            if (write_timeout_ > 0 && getPending(IOObject::OpWrite).empty()) {
+                write_deadline_ = getExecutor()->getNow() + write_timeout_;
+                rearmTimeouts();
+            }
             tok->attach(this);
-            wio_.start();
+            writeQueued(tok.get());
+            // writes produced during this loop iteration are flushed together
+            // before the executor polls, the write watcher is only armed on
+            // EAGAIN or partial write
+            if (!wio_.is_active() && writable())
+                getExecutor()->runBeforePoll(this);
+            else if (s_ == CONNECTED)
+                wio_.start();
         }
         return tok;
     }
@@ -146,6 +176,8 @@ public:
             forceClose();
     }
 
+    void cleanup(CancelReason reason) override;
+
     void shutdownWrite() {
         if (getPending(IOObject::OpWrite).empty()) {
             shutdownWriteNow();
@@ -186,18 +218,149 @@ public:
         return peer_addr_;
     }
 
+    int fd() const { return socket_.fd(); }
+
+    static const size_t kZeroCopyThreshold = 64 * 1024;
+
+    // Send writes of at least `threshold' bytes with MSG_ZEROCOPY. Such a
+    // write completes only after the kernel has released its buffer.
+    // Returns false if the socket does not support zero-copy.
+    virtual bool setZeroCopy(bool enable, size_t threshold = kZeroCopyThreshold);
+
+    void setReadPolicy(const ReadPolicy &policy) override {
+        read_policy_ = policy;
+        read_sizer_.reset(policy);
+    }
+
+    const ReadPolicy &getReadPolicy() const {
+        return read_policy_;
+    }
+
+    // Applied right away once connected, otherwise before connecting.
+    // Throws IOError if the kernel rejects an option.
+    void setOptions(const tcp::SocketOptions &opts) {
+        options_ = opts;
+        if (s_ == CONNECTED || s_ == CONNECTING) {
+            std::error_code ec;
+            socket_.applyOptions(opts, ec);
+            if (ec) throw IOError("setsockopt", ec);
+        }
+    }
+
+    // RTT, congestion window and retransmits for monitoring, throws
+    // IOError on non-TCP sockets
+    tcp::TcpInfo getTcpInfo() const {
+        std::error_code ec;
+        auto info = socket_.getTcpInfo(ec);
+        if (ec) throw IOError("getsockopt", ec);
+        return info;
+    }
+
+    // Timeouts in seconds, 0 (the default) disables them. A pending read
+    // fails with errc::timed_out after the read timeout without data and
+    // the channel stays usable. Pending writes that made no progress for
+    // the write timeout fail the same way and close the channel, as does
+    // the idle timeout without reads or writes. Activity only updates the
+    // deadline, it costs no timer operation.
+    void setReadTimeout(double secs);
+    void setWriteTimeout(double secs);
+    void setIdleTimeout(double secs);
+
+    // bytes copied into the kernel (including zero-copy fallbacks)
+    uint64_t getCopiedBytes() const { return copied_bytes_; }
+    uint64_t getZeroCopiedBytes() const { return zerocopy_bytes_; }
+
+    // Descriptor passing on AF_UNIX channels. Received descriptors are
+    // queued in arrival order and belong to the caller once taken, the
+    // ones still queued are closed with the channel. A descriptor arrives
+    // together with the first byte of the write that carried it.
+    void setReceiveFds(bool enable) { recv_fds_ = enable; }
+    std::vector<int> takeReceivedFds() {
+        std::vector<int> fds;
+        fds.swap(received_fds_);
+        return fds;
+    }
+
     // future API
     static SockConnectFuture connect(EventExecutor *ev, const folly::SocketAddress &addr);
+    static SockConnectFuture connect(EventExecutor *ev, const folly::SocketAddress &addr,
+            const tcp::SocketOptions &opts);
     WriteFuture write(std::unique_ptr<folly::IOBuf> buf);
     ReadStream readStream();
+    // `buf' must not be empty, `fds' only have to stay open until the
+    // write completes since the kernel duplicates them
+    WriteFuture writeWithFds(std::unique_ptr<folly::IOBuf> buf, std::vector<int> fds);
+    // Sends `length' bytes of `file' from `offset' and resolves to the
+    // bytes sent, fewer if the file ends first. Regular files go through
+    // sendfile(2) in order with the other writes. TLS channels and other
+    // files read through the file's engine and write the buffers.
+    BoxedFuture<ssize_t> sendFile(AsyncFile::Ptr file, off_t offset, size_t length);
+
+    // sendfile(2) would bypass channels that transform the byte stream
+    virtual bool canSendFile() const { return true; }
+    // splice(2) from and to the socket, same restrictions as readv()
+    // and sendfile(2)
+    bool canSplice() const { return canSendFile() && canScatterRead(); }
 
 protected:
     tcp::Socket socket_;
     folly::SocketAddress peer_addr_;
     State s_ = INITED;
     int shutdown_flags_ = 0;
-    ev::io rio_;
-    ev::io wio_;
+    FdWatcher rio_;
+    FdWatcher wio_;
+    std::vector<iovec> wvec_;
+    ReadPolicy read_policy_;
+    AdaptiveReadSizer read_sizer_;
+    tcp::SocketOptions options_;
+    bool recv_fds_ = false;
+    std::vector<int> received_fds_;
+    // over the executor's memory budget
+    bool read_paused_ = false;
+
+    // zero-copy state, zc_threshold_ == 0 means disabled
+    size_t zc_threshold_ = 0;
+    uint32_t zc_next_id_ = 0;
+    std::deque<std::pair<uint32_t, size_t>> zc_sends_;
+    // buffers of zero-copy writes cancelled before their completion, the
+    // kernel may still read them
+    std::deque<std::pair<uint32_t, std::unique_ptr<folly::IOBuf>>> zc_held_;
+    uint64_t copied_bytes_ = 0;
+    uint64_t zerocopy_bytes_ = 0;
+
+    struct ZeroCopyPollEntry : public DeadlineQueue::Entry {
+        SocketChannel *channel;
+
+        explicit ZeroCopyPollEntry(SocketChannel *channel) : channel(channel) {}
+
+        void onDeadline() override {
+            channel->pollZeroCopy();
+        }
+    };
+
+    // polls the error queue when the read watcher can't wait for it
+    ZeroCopyPollEntry zc_poll_entry_{this};
+    static constexpr double kZeroCopyPollInterval = 0.001;
+
+    struct TimeoutEntry : public DeadlineQueue::Entry {
+        SocketChannel *channel;
+
+        explicit TimeoutEntry(SocketChannel *channel) : channel(channel) {}
+
+        void onDeadline() override {
+            channel->onTimeout();
+        }
+    };
+
+    // one entry on the executor's DeadlineQueue for all three timeouts,
+    // a deadline of 0 is not set
+    TimeoutEntry timeout_entry_{this};
+    double read_timeout_ = 0;
+    double write_timeout_ = 0;
+    double idle_timeout_ = 0;
+    double read_deadline_ = 0;
+    double write_deadline_ = 0;
+    double idle_deadline_ = 0;
 
     virtual ssize_t performWrite(
             const iovec* vec,
@@ -206,11 +369,31 @@ protected:
             size_t* partialWritten,
             std::error_code &ec);
 
+    virtual bool writable() const {
+        return s_ == CONNECTED;
+    }
+
+    void handleWrite();
+    bool sendFileRange(WriterCompletionToken *p, std::error_code &ec);
+    void handleZeroCopyCompletion();
+    void schedulePollZeroCopy();
+    void pollZeroCopy();
+    void runLoopCallback() override {
+        if (writable())
+            handleWrite();
+    }
     ssize_t handleRead(ReaderCompletionToken *tok, std::error_code &ec);
     virtual ssize_t performRead(void *buf, size_t bufLen, std::error_code &ec);
+    ssize_t performReadv(const iovec *vec, size_t count, std::error_code &ec);
+    // readv() straight from the socket, channels that transform the byte
+    // stream read through performRead()
+    virtual bool canScatterRead() const { return !recv_fds_; }
 
     void onEvent(ev::io& watcher, int revent);
 
+    void pauseReading() override;
+    void resumeReading() override;
+
     void closeRead() {
         rio_.stop();
         shutdown_flags_ |= SHUT_READ;
@@ -218,9 +401,17 @@ protected:
     }
 
     void forceClose() {
-        wio_.stop();
-        rio_.stop();
-        socket_.close();
+        cancelLoopCallback();
+        timeout_entry_.unlink();
+        wio_.reset();
+        rio_.reset();
+        if (zc_sends_.empty()) {
+            socket_.close();
+        } else {
+            // closed once the kernel released the buffers still sent from
+            ::shutdown(socket_.fd(), SHUT_RDWR);
+            schedulePollZeroCopy();
+        }
         s_ = CLOSED;
         shutdown_flags_ |= (SHUT_READ | SHUT_WRITE);
     }
@@ -234,6 +425,31 @@ protected:
     }
 
     void handleInitialReadWrite();
+
+    void touchRead() {
+        if (read_timeout_ <= 0 && idle_timeout_ <= 0)
+            return;
+        double now = getExecutor()->getNow();
+        if (read_timeout_ > 0)
+            read_deadline_ = now + read_timeout_;
+        if (idle_timeout_ > 0)
+            idle_deadline_ = now + idle_timeout_;
+        rearmTimeouts();
+    }
+
+    void touchWrite() {
+        if (write_timeout_ <= 0 && idle_timeout_ <= 0)
+            return;
+        double now = getExecutor()->getNow();
+        if (write_timeout_ > 0)
+            write_deadline_ = now + write_timeout_;
+        if (idle_timeout_ > 0)
+            idle_deadline_ = now + idle_timeout_;
+        rearmTimeouts();
+    }
+
+    void rearmTimeouts();
+    void onTimeout();
 };
 
 class SockConnectFuture : public FutureBase<SockConnectFuture, SocketChannel::Ptr> {
@@ -243,6 +459,12 @@ public:
     SockConnectFuture(EventExecutor *ev, const folly::SocketAddress &addr)
         : ptr_(std::make_shared<SocketChannel>(ev)), addr_(addr) {}
 
+    SockConnectFuture(EventExecutor *ev, const folly::SocketAddress &addr,
+            const tcp::SocketOptions &opts)
+        : ptr_(std::make_shared<SocketChannel>(ev)), addr_(addr) {
+        ptr_->setOptions(opts);
+    }
+
     Poll<Item> poll() override {
         if (!ptr_) throw InvalidPollStateException();
         if (!tok_)
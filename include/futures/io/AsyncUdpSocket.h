@@ -0,0 +1,205 @@
+#pragma once
+
+#include <futures/io/WaitHandleBase.h>
+#include <futures/core/IOBuf.h>
+#include <futures/core/SocketAddress.h>
+#include <futures/AsyncSink.h>
+#include <futures/Stream.h>
+#include <deque>
+#include <vector>
+
+namespace futures {
+namespace io {
+
+using Datagram = std::tuple<std::unique_ptr<folly::IOBuf>, folly::SocketAddress>;
+
+class UdpRecvStream;
+class UdpSendSink;
+
+// Datagram socket, receives with recvmmsg and sends with sendmmsg so a busy
+// socket costs one syscall per batch instead of one per datagram.
+class AsyncUdpSocket
+    : public IOObject,
+      public std::enable_shared_from_this<AsyncUdpSocket> {
+public:
+    using Ptr = std::shared_ptr<AsyncUdpSocket>;
+
+    // datagrams per recvmmsg/sendmmsg call
+    static const size_t kMaxBatch = 32;
+    // received datagrams queued before reading pauses
+    static const size_t kMaxQueued = 1024;
+
+    AsyncUdpSocket(EventExecutor *ev, const folly::SocketAddress &bind);
+    ~AsyncUdpSocket();
+
+    struct RecvCompletionToken : public io::CompletionToken {
+        std::error_code ec;
+        std::deque<Datagram> q_;
+
+        RecvCompletionToken()
+            : io::CompletionToken(IOObject::OpRead) {
+        }
+
+        void onCancel(CancelReason r) override {
+        }
+
+        Poll<Optional<Datagram>> pollStream();
+
+        void append(Datagram&& item) {
+            q_.push_back(std::move(item));
+        }
+    protected:
+        ~RecvCompletionToken() {
+            cleanup(CancelReason::UserCancel);
+        }
+    };
+
+    struct SendCompletionToken : public io::CompletionToken {
+        std::error_code ec;
+        std::vector<Datagram> dgrams_;
+        // datagrams handed to the kernel so far
+        size_t sent_ = 0;
+
+        SendCompletionToken(std::vector<Datagram> dgrams)
+            : io::CompletionToken(IOObject::OpWrite), dgrams_(std::move(dgrams)) {
+        }
+
+        void onCancel(CancelReason r) override {
+        }
+
+        void sendError(std::error_code e) {
+            ec = e;
+            notifyDone();
+        }
+
+        Poll<ssize_t> poll() {
+            switch (getState()) {
+            case STARTED:
+                park();
+                return Poll<ssize_t>(not_ready);
+            case DONE:
+                if (ec)
+                    return Poll<ssize_t>(IOError("sendmmsg", ec));
+                else
+                    return makePollReady(static_cast<ssize_t>(sent_));
+            case CANCELLED:
+                return Poll<ssize_t>(FutureCancelledException());
+            default:
+                throw InvalidPollStateException();
+            }
+        }
+    protected:
+        ~SendCompletionToken() {
+            cleanup(CancelReason::UserCancel);
+        }
+    };
+
+    io::intrusive_ptr<RecvCompletionToken> doRecv();
+    io::intrusive_ptr<SendCompletionToken> doSend(std::vector<Datagram> dgrams);
+
+    inline UdpRecvStream recv();
+    inline UdpSendSink sink();
+
+    folly::SocketAddress getLocalAddress() const;
+
+    // UDP_GRO: the kernel may hand over several datagrams of one flow in a
+    // single receive, they are split again before being queued. Returns
+    // false if the kernel does not support it.
+    bool setGro(bool enable);
+    // UDP_SEGMENT: consecutive datagrams to the same peer that all have
+    // `segment_size' bytes (the last may be shorter) are sent as one
+    // message and segmented by the kernel or the NIC. 0 disables.
+    bool setGso(uint16_t segment_size);
+
+    // receive slot per datagram, longer datagrams are dropped
+    void setMaxDatagramSize(size_t size) { max_dgram_ = size; }
+
+    int fd() const { return fd_; }
+
+    void forceClose();
+
+    void onCancel(CancelReason reason) override {
+        if (fd_ >= 0)
+            forceClose();
+    }
+
+private:
+    int fd_ = -1;
+    ev::io rio_;
+    ev::io wio_;
+    size_t max_dgram_ = 2048;
+    uint16_t gso_size_ = 0;
+    bool gro_ = false;
+    std::vector<iovec> send_iov_;
+
+    void onEvent(ev::io& watcher, int revent);
+    void handleRead();
+    void handleWrite();
+    void resumeRead();
+};
+
+class UdpRecvStream : public StreamBase<UdpRecvStream, Datagram> {
+public:
+    using Item = Datagram;
+
+    UdpRecvStream(AsyncUdpSocket::Ptr sock)
+        : sock_(sock) {
+    }
+
+    Poll<Optional<Item>> poll() override {
+        if (!tok_)
+            tok_ = sock_->doRecv();
+        return tok_->pollStream();
+    }
+private:
+    AsyncUdpSocket::Ptr sock_;
+    io::intrusive_ptr<AsyncUdpSocket::RecvCompletionToken> tok_;
+};
+
+// Queues datagrams in startSend() and sends whatever accumulated as one
+// batch in pollComplete().
+class UdpSendSink : public AsyncSinkBase<UdpSendSink, Datagram> {
+public:
+    using Out = Datagram;
+
+    UdpSendSink(AsyncUdpSocket::Ptr sock)
+        : sock_(sock) {
+    }
+
+    Try<void> startSend(Out&& item) override {
+        q_.push_back(std::move(item));
+        return Try<void>();
+    }
+
+    Poll<Unit> pollComplete() override {
+        while (true) {
+            if (!send_req_) {
+                if (q_.empty()) return makePollReady(folly::unit);
+                send_req_ = sock_->doSend(std::move(q_));
+                q_.clear();
+            }
+            auto r = send_req_->poll();
+            if (r.hasException())
+                return Poll<Unit>(r.exception());
+            if (!r->hasValue())
+                return Poll<Unit>(not_ready);
+            send_req_.reset();
+        }
+    }
+
+private:
+    AsyncUdpSocket::Ptr sock_;
+    std::vector<Datagram> q_;
+    io::intrusive_ptr<AsyncUdpSocket::SendCompletionToken> send_req_;
+};
+
+UdpRecvStream AsyncUdpSocket::recv() {
+    return UdpRecvStream(shared_from_this());
+}
+
+UdpSendSink AsyncUdpSocket::sink() {
+    return UdpSendSink(shared_from_this());
+}
+
+}
+}
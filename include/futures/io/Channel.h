@@ -1,11 +1,15 @@
 #pragma once
 
 #include <futures/io/WaitHandleBase.h>
+#include <futures/io/ReadPolicy.h>
 #include <futures/core/IOBuf.h>
+#include <cstring>
 
 namespace futures {
 namespace io {
 
+class Channel;
+
 class ReaderCompletionToken : public io::CompletionToken {
 public:
     ReaderCompletionToken()
@@ -13,20 +17,53 @@ public:
     }
 
     void onCancel(CancelReason r) override {
+        setBuffered(0);
     }
 
     virtual void readEof() {
+        setBuffered(0);
         notifyDone();
     }
 
     virtual void readError(std::error_code ec) {
         ec_ = ec;
+        setBuffered(0);
         notifyDone();
     }
 
     virtual void dataReady(ssize_t size) = 0;
     virtual void prepareBuffer(void **buf, size_t *data) = 0;
 
+    // Bytes read into the executor's shared read buffer, the default
+    // implementation copies them into the buffers from prepareBuffer().
+    virtual void dataReceived(const void *data, size_t len) {
+        auto src = static_cast<const char*>(data);
+        while (len > 0) {
+            void *buf;
+            size_t bufLen = 0;
+            prepareBuffer(&buf, &bufLen);
+            size_t n = std::min(len, bufLen);
+            memcpy(buf, src, n);
+            dataReady(n);
+            src += n;
+            len -= n;
+        }
+    }
+
+    // Scatter reads: fill `vec' with at most `maxVec' buffers of at most
+    // `len' bytes in total, e.g. the tailroom of the current buffer
+    // followed by fresh segments, and return how many. The channel then
+    // reads into all of them with a single readv() and reports the bytes
+    // with buffersFilled(). 0, the default, reads through dataReceived().
+    virtual size_t prepareBuffers(iovec *vec, size_t maxVec, size_t len) {
+        return 0;
+    }
+
+    // `n' bytes were read into the buffers of the last prepareBuffers(),
+    // in order, the unused ones may be released
+    virtual void buffersFilled(size_t n) {
+    }
+
     ~ReaderCompletionToken() {
         cleanup(CancelReason::UserCancel);
     }
@@ -35,14 +72,26 @@ public:
         return ec_;
     }
 
+protected:
+    // Bytes read but not consumed yet, charged to the channel's memory
+    // while the token is attached
+    inline void setBuffered(size_t n);
+
+    // keep setBuffered() charging the channel once the token is done, the
+    // caller keeps the channel alive until the bytes are released
+    inline void keepCharging();
+
 private:
     std::error_code ec_;
+    size_t charged_ = 0;
+    Channel *done_channel_ = nullptr;
 };
 
 class WriterCompletionToken : public io::CompletionToken {
 public:
     WriterCompletionToken(std::unique_ptr<folly::IOBuf> buf)
         : io::CompletionToken(IOObject::OpWrite), buf_(std::move(buf)) {
+        total_ = buf_->computeChainDataLength();
         size_t chain_len = buf_->countChainElements();
         if (!chain_len)
             throw std::invalid_argument("empty chain");
@@ -56,11 +105,40 @@ public:
         }
     }
 
+    // sends `length' bytes of `file_fd' from `offset' with sendfile(2)
+    // instead of a buffer, the descriptor has to stay open until done
+    WriterCompletionToken(int file_fd, off_t offset, size_t length)
+        : io::CompletionToken(IOObject::OpWrite),
+          file_fd_(file_fd), file_offset_(offset), file_remain_(length),
+          total_(length) {
+    }
+
     virtual void writeError(std::error_code ec) {
         ec_ = ec;
+        drained(queued_);
         notifyDone();
     }
 
+    // bytes not handed to the kernel yet
+    size_t getRemaining() const {
+        return total_ - written_;
+    }
+
+    bool isFileRange() const {
+        return file_fd_ >= 0;
+    }
+
+    int getFileFd() const { return file_fd_; }
+    off_t getFileOffset() const { return file_offset_; }
+    size_t getFileRemaining() const { return file_remain_; }
+
+    void fileSent(size_t n) {
+        written_ += n;
+        file_offset_ += n;
+        file_remain_ -= n;
+        drained(n);
+    }
+
     virtual void prepareIov(struct iovec **vec, size_t *vecLen) {
         *vecLen = iovec_len_;
         *vec = piovec_;
@@ -68,6 +146,7 @@ public:
 
     virtual void updateIov(ssize_t totalWritten, size_t countWritten, size_t partialWritten) {
         written_ += totalWritten;
+        drained(totalWritten);
         piovec_ += countWritten;
         iovec_len_ -= countWritten;
         if (iovec_len_ > 0) {
@@ -77,6 +156,42 @@ public:
     }
 
     void onCancel(CancelReason r) override {
+        drained(queued_);
+    }
+
+    // fully sent with MSG_ZEROCOPY, done once the kernel releases the
+    // buffer (completion id reaches `id')
+    void setZeroCopyPending(uint32_t id) {
+        zc_pending_ = true;
+        zc_id_ = id;
+    }
+
+    bool isZeroCopyPending() const {
+        return zc_pending_;
+    }
+
+    uint32_t getZeroCopyId() const {
+        return zc_id_;
+    }
+
+    // the buffer of a zero-copy send, for the channel to hold on to
+    // when the write is cancelled before the kernel released it
+    std::unique_ptr<folly::IOBuf> releaseBuffer() {
+        return std::move(buf_);
+    }
+
+    // descriptors passed with the first byte of this write (SCM_RIGHTS),
+    // cleared once they are sent
+    void setPassedFds(std::vector<int> fds) {
+        fds_ = std::move(fds);
+    }
+
+    const std::vector<int> &getPassedFds() const {
+        return fds_;
+    }
+
+    void clearPassedFds() {
+        fds_.clear();
     }
 
     virtual Poll<ssize_t> poll() {
@@ -112,10 +227,22 @@ private:
     std::vector<struct iovec> vec_;
     iovec *piovec_ = nullptr;
     size_t iovec_len_ = 0;
+    bool zc_pending_ = false;
+    uint32_t zc_id_ = 0;
+    std::vector<int> fds_;
+    int file_fd_ = -1;
+    off_t file_offset_ = 0;
+    size_t file_remain_ = 0;
+    size_t total_ = 0;
+    // still counted in the channel's buffered bytes
+    size_t queued_ = 0;
+
+    friend class Channel;
+    inline void drained(size_t n);
 };
 
 
-class Channel : public IOObject {
+class Channel : public IOObject, public MemoryBudget::Account {
 public:
     using Ptr = std::shared_ptr<Channel>;
 
@@ -127,7 +254,108 @@ public:
 
     virtual io::intrusive_ptr<WriterCompletionToken> doWrite(std::unique_ptr<WriterCompletionToken> p) = 0;
     virtual io::intrusive_ptr<ReaderCompletionToken> doRead(std::unique_ptr<ReaderCompletionToken> p) = 0;
+
+    // read sizing hint, channels without adaptive reads ignore it
+    virtual void setReadPolicy(const ReadPolicy &policy) {}
+
+    // Backpressure on bytes queued with doWrite() that the kernel has not
+    // taken yet, a `high' of 0 (the default) leaves them unbounded. Once
+    // `high' bytes are buffered pollWritable() is not ready until they
+    // drained to `low', the waiting tasks are woken then.
+    void setWriteWatermarks(size_t low, size_t high) {
+        assert(low <= high);
+        write_low_ = low;
+        write_high_ = high;
+        checkWritable();
+    }
+
+    size_t getWriteBuffered() const { return write_buffered_; }
+    size_t getWriteHighWatermark() const { return write_high_; }
+    size_t getWriteLowWatermark() const { return write_low_; }
+
+    Poll<folly::Unit> pollWritable() {
+        if (write_high_ && write_buffered_ >= write_high_)
+            write_blocked_ = true;
+        checkWritable();
+        if (!write_blocked_)
+            return makePollReady(folly::unit);
+        Task task = CurrentTask::park();
+        for (auto &t : write_waiters_)
+            if (t.Id() == task.Id())
+                return Poll<folly::Unit>(not_ready);
+        write_waiters_.push_back(std::move(task));
+        return Poll<folly::Unit>(not_ready);
+    }
+
+    // Bytes held for this channel, counted against the executor's
+    // MemoryBudget along with the buffered writes: readers report what
+    // they read but not consumed yet, sinks their encoded frames, servers
+    // may add decoded requests not handled yet.
+    void chargeMemory(ssize_t delta) {
+        getExecutor()->getMemoryBudget().charge(this, delta);
+    }
+
+protected:
+    // account a write attached by doWrite()
+    void writeQueued(WriterCompletionToken *tok) {
+        tok->queued_ = tok->getRemaining();
+        write_buffered_ += tok->queued_;
+        chargeMemory(tok->queued_);
+    }
+
+    // over the memory budget, channels that cannot stop reading ignore it
+    void pauseReading() override {}
+    void resumeReading() override {}
+
+private:
+    size_t write_low_ = 0;
+    size_t write_high_ = 0;
+    size_t write_buffered_ = 0;
+    bool write_blocked_ = false;
+    std::vector<Task> write_waiters_;
+
+    friend class WriterCompletionToken;
+
+    void writeDrained(size_t n) {
+        write_buffered_ -= n;
+        chargeMemory(-(ssize_t)n);
+        checkWritable();
+    }
+
+    void checkWritable() {
+        if (!write_blocked_
+                || (write_high_ && write_buffered_ > write_low_))
+            return;
+        write_blocked_ = false;
+        std::vector<Task> waiters;
+        waiters.swap(write_waiters_);
+        for (auto &t : waiters)
+            t.unpark();
+    }
 };
 
+void ReaderCompletionToken::setBuffered(size_t n) {
+    auto channel = static_cast<Channel*>(getIOObject());
+    if (!channel)
+        channel = done_channel_;
+    if (!channel || n == charged_)
+        return;
+    channel->chargeMemory((ssize_t)n - (ssize_t)charged_);
+    charged_ = n;
+}
+
+void ReaderCompletionToken::keepCharging() {
+    done_channel_ = static_cast<Channel*>(getIOObject());
+}
+
+void WriterCompletionToken::drained(size_t n) {
+    n = std::min(n, queued_);
+    if (!n)
+        return;
+    queued_ -= n;
+    if (auto channel = static_cast<Channel*>(getIOObject()))
+        channel->writeDrained(n);
+}
+
 }
 }
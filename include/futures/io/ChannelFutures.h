@@ -11,17 +11,45 @@ class WriteFuture : public FutureBase<WriteFuture, ssize_t> {
 public:
     using Item = ssize_t;
 
-    WriteFuture(Channel::Ptr ptr, std::unique_ptr<folly::IOBuf> buf)
-        : ptr_(ptr), buf_(std::move(buf)) {}
+    WriteFuture(Channel::Ptr ptr, std::unique_ptr<folly::IOBuf> buf,
+            std::vector<int> fds = std::vector<int>())
+        : ptr_(ptr), buf_(std::move(buf)), fds_(std::move(fds)) {}
 
     Poll<Item> poll() override {
-        if (!tok_)
-            tok_ = ptr_->doWrite(folly::make_unique<WriterCompletionToken>(std::move(buf_)));
+        if (!tok_) {
+            auto p = folly::make_unique<WriterCompletionToken>(std::move(buf_));
+            if (!fds_.empty())
+                p->setPassedFds(std::move(fds_));
+            tok_ = ptr_->doWrite(std::move(p));
+        }
         return tok_->poll();
     }
 private:
     Channel::Ptr ptr_;
     std::unique_ptr<folly::IOBuf> buf_;
+    std::vector<int> fds_;
+    io::intrusive_ptr<WriterCompletionToken> tok_;
+};
+
+class SendFileFuture : public FutureBase<SendFileFuture, ssize_t> {
+public:
+    using Item = ssize_t;
+
+    SendFileFuture(Channel::Ptr ptr, AsyncFile::Ptr file, off_t offset, size_t length)
+        : ptr_(ptr), file_(file), offset_(offset), length_(length) {}
+
+    Poll<Item> poll() override {
+        if (!tok_) {
+            tok_ = ptr_->doWrite(folly::make_unique<WriterCompletionToken>(
+                        file_->fd(), offset_, length_));
+        }
+        return tok_->poll();
+    }
+private:
+    Channel::Ptr ptr_;
+    AsyncFile::Ptr file_;
+    off_t offset_;
+    size_t length_;
     io::intrusive_ptr<WriterCompletionToken> tok_;
 };
 
@@ -40,6 +68,8 @@ public:
                     park();
                     return Poll<Optional<Item>>(not_ready);
                 } else {
+                    buffered_ = 0;
+                    setBuffered(0);
                     return makePollReady(Optional<Item>(std::move(buf_)));
                 }
             case DONE:
@@ -70,10 +100,24 @@ public:
 
         void dataReady(ssize_t size) override {
             buf_->prev()->append(size);
+            buffered_ += size;
+            setBuffered(buffered_);
+            notify();
+        }
+
+        void dataReceived(const void *data, size_t len) override {
+            auto buf = folly::IOBuf::copyBuffer(data, len);
+            if (buf_)
+                buf_->prependChain(std::move(buf));
+            else
+                buf_ = std::move(buf);
+            buffered_ += len;
+            setBuffered(buffered_);
             notify();
         }
     private:
         std::unique_ptr<folly::IOBuf> buf_;
+        size_t buffered_ = 0;
     };
 
     ReadStream(Channel::Ptr ptr)
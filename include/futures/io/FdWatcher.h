@@ -0,0 +1,115 @@
+#pragma once
+
+#include <futures/EventExecutor.h>
+
+namespace futures {
+namespace io {
+
+// Drop-in for the subset of ev::io the channels use. Goes through the
+// executor's Reactor if it has one, libev otherwise.
+//
+// Reactors may be edge-triggered: a watcher is called again only after
+// clearReady() or when it stays ready, so a handler that stops before
+// EAGAIN (e.g. out of read budget) is simply called again next iteration.
+class FdWatcher {
+public:
+    FdWatcher(EventExecutor *ev)
+        : io_(ev->getLoop()), reactor_(ev->getReactor()) {
+    }
+
+    ~FdWatcher() {
+        reset();
+    }
+
+    template <class K, void (K::*method)(ev::io &w, int revents)>
+    void set(K *object) {
+        io_.set<K, method>(object);
+        obj_ = object;
+        cb_ = &thunk<K, method>;
+    }
+
+    void set(int fd, int events) {
+        if (!reactor_) {
+            io_.set(fd, events);
+            return;
+        }
+        if (attached_ && fd != fd_)
+            detach();
+        fd_ = fd;
+        events_ = events;
+        if (fd_ >= 0 && !attached_) {
+            reactor_->attach(this);
+            attached_ = true;
+        }
+    }
+
+    void start() {
+        if (!reactor_) {
+            io_.start();
+        } else if (!active_) {
+            active_ = true;
+            reactor_->update(this);
+        }
+    }
+
+    void stop() {
+        if (!reactor_) {
+            io_.stop();
+        } else if (active_) {
+            active_ = false;
+            reactor_->update(this);
+        }
+    }
+
+    bool is_active() const {
+        return reactor_ ? active_ : io_.is_active();
+    }
+
+    void clearReady() {
+        if (reactor_ && attached_)
+            reactor_->clearReady(this);
+    }
+
+    // forget the fd, call before closing it
+    void reset() {
+        stop();
+        if (attached_)
+            detach();
+    }
+
+    int fd() const { return fd_; }
+    int events() const { return events_; }
+
+    void invoke(int revents) {
+        cb_(obj_, io_, revents);
+    }
+
+    // owned by the reactor
+    void *reactor_data = nullptr;
+
+    FdWatcher(const FdWatcher&) = delete;
+    FdWatcher& operator=(const FdWatcher&) = delete;
+
+private:
+    ev::io io_;
+    Reactor *reactor_;
+    int fd_ = -1;
+    int events_ = 0;
+    bool active_ = false;
+    bool attached_ = false;
+    void *obj_ = nullptr;
+    void (*cb_)(void*, ev::io&, int) = nullptr;
+
+    void detach() {
+        reactor_->detach(this);
+        attached_ = false;
+    }
+
+    template <class K, void (K::*method)(ev::io &w, int revents)>
+    static void thunk(void *obj, ev::io &w, int revents) {
+        (static_cast<K*>(obj)->*method)(w, revents);
+    }
+};
+
+}
+}
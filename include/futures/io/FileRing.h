@@ -0,0 +1,153 @@
+#pragma once
+
+#include <futures/io/WaitHandleBase.h>
+#include <futures/core/IOBuf.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+#include <system_error>
+
+struct io_uring_sqe;
+
+namespace futures {
+namespace io {
+
+// io_uring instance owned by one EventExecutor. Operations queued during a
+// loop iteration are submitted with a single io_uring_enter before the
+// loop polls, completions wake the loop through an eventfd. Only use it
+// from the executor's thread.
+class FileRing
+    : public IOObject,
+      public LoopCallback,
+      public std::enable_shared_from_this<FileRing> {
+public:
+    using Ptr = std::shared_ptr<FileRing>;
+
+    static const unsigned kEntries = 256;
+
+    // nullptr if the kernel has no io_uring, lacks one of the opcodes used
+    // below or it is not permitted
+    static Ptr create(EventExecutor *ev, unsigned entries = kEntries);
+
+    FileRing(EventExecutor *ev, int ring_fd, int event_fd, unsigned entries);
+    ~FileRing();
+
+    struct CompletionToken : public io::CompletionToken {
+        // syscall result, -errno on failure
+        int res = 0;
+        const char *what;
+        // kept alive until the kernel is done with them, which may be after
+        // the future was dropped
+        std::unique_ptr<folly::IOBuf> buf;
+        std::vector<iovec> iov;
+        std::string path;
+
+        CompletionToken(const char *what)
+            : io::CompletionToken(IOObject::OpRead), what(what) {
+        }
+
+        void onCancel(CancelReason r) override {
+        }
+
+        Poll<int> poll() {
+            switch (getState()) {
+            case STARTED:
+                park();
+                return Poll<int>(not_ready);
+            case DONE:
+                if (res < 0)
+                    return Poll<int>(std::system_error(-res,
+                                std::system_category(), what));
+                return makePollReady(res);
+            case CANCELLED:
+                return Poll<int>(FutureCancelledException());
+            default:
+                throw InvalidPollStateException();
+            }
+        }
+    protected:
+        ~CompletionToken() {
+            cleanup(CancelReason::UserCancel);
+        }
+    };
+
+    using TokenPtr = io::intrusive_ptr<CompletionToken>;
+
+    // `offset' -1 reads or writes at the file position
+    TokenPtr read(int fd, std::unique_ptr<folly::IOBuf> buf, off_t offset = -1);
+    TokenPtr write(int fd, std::unique_ptr<folly::IOBuf> buf, off_t offset = -1);
+    // `iov' points into `buf'
+    TokenPtr readv(int fd, std::unique_ptr<folly::IOBuf> buf,
+            std::vector<iovec> iov, off_t offset = -1);
+    TokenPtr writev(int fd, std::unique_ptr<folly::IOBuf> buf,
+            std::vector<iovec> iov, off_t offset = -1);
+    TokenPtr fsync(int fd, bool data_only);
+    TokenPtr openat(const std::string &path, int flags, mode_t mode);
+    TokenPtr close(int fd);
+
+    // queued for the next submission or submitted, until reaped
+    size_t inflight() const { return inflight_ + unsubmitted_; }
+
+    void onCancel(CancelReason reason) override {
+    }
+
+private:
+    int ring_fd_;
+    int event_fd_;
+    ev::io eio_;
+
+    void *sq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    void *cq_ring_ = nullptr;
+    size_t cq_ring_size_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned *sq_head_;
+    unsigned *sq_tail_;
+    unsigned *sq_array_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned *cq_head_;
+    unsigned *cq_tail_;
+    void *cqes_;
+    unsigned cq_mask_;
+    unsigned cq_entries_;
+
+    // queued but not yet submitted, and submitted but not yet completed
+    unsigned unsubmitted_ = 0;
+    size_t inflight_ = 0;
+
+    bool mapRings(const void *params);
+    TokenPtr prepare(const char *what, io_uring_sqe **sqe);
+    void submit(bool wait);
+    void reap();
+    void onEvent(ev::io &watcher, int revent);
+    void runLoopCallback() override {
+        submit(false);
+    }
+};
+
+class FileRingFuture : public FutureBase<FileRingFuture, FileRing::TokenPtr> {
+public:
+    using Item = FileRing::TokenPtr;
+
+    FileRingFuture(FileRing::TokenPtr tok)
+        : tok_(std::move(tok)) {
+    }
+
+    Poll<Item> poll() override {
+        auto r = tok_->poll();
+        if (r.hasException())
+            return Poll<Item>(r.exception());
+        if (!r->hasValue())
+            return Poll<Item>(not_ready);
+        return makePollReady(std::move(tok_));
+    }
+
+private:
+    FileRing::TokenPtr tok_;
+};
+
+}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <futures/io/AsyncSocket.h>
+#include <futures/dns/Resolver.h>
+#include <futures/Timer.h>
+#include <functional>
+
+namespace futures {
+namespace io {
+
+// Connection racing over resolver results (RFC 8305). Addresses are tried
+// with families interleaved, IPv6 first, a new attempt starting every
+// `delay' seconds or as soon as the previous one failed. The first
+// connected channel wins and the other attempts are dropped, which
+// closes their sockets. Fails with the error of the last attempt.
+class HappyEyeballsFuture
+    : public FutureBase<HappyEyeballsFuture, SocketChannel::Ptr> {
+public:
+    using Item = SocketChannel::Ptr;
+    // makes one attempt, e.g. a TLS connect including the handshake
+    using Connector = std::function<BoxedFuture<SocketChannel::Ptr>(
+            const folly::SocketAddress&)>;
+
+    static constexpr double kAttemptDelay = 0.25;
+
+    // plain SocketChannel::connect() when `connector' is empty
+    HappyEyeballsFuture(EventExecutor *ev, const dns::ResolverResult &addrs,
+            uint16_t port, Connector connector = Connector(),
+            double delay = kAttemptDelay);
+
+    Poll<Item> poll() override;
+
+    // `addrs' reordered IPv6, IPv4, IPv6, ... keeping the order within
+    // each family
+    static dns::ResolverResult interleave(const dns::ResolverResult &addrs);
+
+private:
+    EventExecutor *ev_;
+    std::vector<folly::SocketAddress> addrs_;
+    Connector connector_;
+    double delay_;
+    size_t next_ = 0;
+    std::vector<BoxedFuture<SocketChannel::Ptr>> attempts_;
+    Optional<TimerFuture> timer_;
+    folly::exception_wrapper error_;
+
+    void startNext();
+};
+
+inline HappyEyeballsFuture connectHappyEyeballs(EventExecutor *ev,
+        const dns::ResolverResult &addrs, uint16_t port,
+        HappyEyeballsFuture::Connector connector = HappyEyeballsFuture::Connector()) {
+    return HappyEyeballsFuture(ev, addrs, port, std::move(connector));
+}
+
+}
+}
@@ -7,6 +7,8 @@
 #include <futures/io/Channel.h>
 #include <futures/codec/Codec.h>
 #include <futures/core/IOBufQueue.h>
+#include <deque>
+#include <vector>
 
 namespace futures {
 namespace io {
@@ -25,8 +27,15 @@ public:
             q_(folly::IOBufQueue::cacheChainLength()), codec_(codec) {
         }
 
+        ~FramedStreamReader() {
+            setBuffered(0);
+        }
+
         void readEof() override {
-            ReaderCompletionToken::readEof();
+            // frames still queued stay charged until decoded, the stream
+            // holds the channel as long as this token
+            keepCharging();
+            notifyDone();
         }
 
         void prepareBuffer(void **ptr, size_t *len) override {
@@ -38,9 +47,63 @@ public:
         void dataReady(ssize_t size) override {
             q_.postallocate(size);
             if (size > 0) readable_ = true;
+            setBuffered(q_.chainLength());
+            notify();
+        }
+
+        void dataReceived(const void *data, size_t len) override {
+            // only keep the bytes received, reuse tailroom of a partial frame
+            if (q_.tailroom() >= len)
+                q_.append(data, len);
+            else
+                q_.append(folly::IOBuf::copyBuffer(data, len));
+            if (len > 0) readable_ = true;
+            setBuffered(q_.chainLength());
             notify();
         }
 
+        // the queue's tailroom, then fresh segments appended as they fill
+        size_t prepareBuffers(iovec *vec, size_t maxVec, size_t len) override {
+            size_t n = 0;
+            scatter_tail_ = std::min<size_t>(q_.tailroom(), len);
+            if (scatter_tail_ > 0 && maxVec > 0) {
+                vec[n].iov_base = q_.preallocate(1, kRdBufSize, len).first;
+                vec[n].iov_len = scatter_tail_;
+                len -= scatter_tail_;
+                n++;
+            }
+            scatter_.clear();
+            while (len > 0 && n < maxVec) {
+                auto seg = folly::IOBuf::create(kRdBufSize);
+                vec[n].iov_base = seg->writableTail();
+                vec[n].iov_len = std::min<size_t>(seg->tailroom(), len);
+                len -= vec[n].iov_len;
+                scatter_.push_back(std::move(seg));
+                n++;
+            }
+            return n;
+        }
+
+        void buffersFilled(size_t n) override {
+            if (n > 0) readable_ = true;
+            size_t tail = std::min(n, scatter_tail_);
+            if (tail > 0)
+                q_.postallocate(tail);
+            n -= tail;
+            for (auto &seg : scatter_) {
+                if (n == 0)
+                    break;
+                size_t used = std::min<size_t>(n, seg->tailroom());
+                seg->append(used);
+                q_.append(std::move(seg));
+                n -= used;
+            }
+            scatter_.clear();
+            scatter_tail_ = 0;
+            setBuffered(q_.chainLength());
+            if (readable_) notify();
+        }
+
         Poll<Optional<Item>> pollStream() {
             switch (getState()) {
                 case STARTED:
@@ -56,6 +119,9 @@ public:
         std::shared_ptr<codec::DecoderBase<T>> codec_;
         bool eof_;
         bool readable_;
+        // buffers offered by the last prepareBuffers()
+        size_t scatter_tail_ = 0;
+        std::vector<std::unique_ptr<folly::IOBuf>> scatter_;
 
         Poll<Optional<Item>> pollOneItem() {
             if (getErrorCode())
@@ -66,7 +132,9 @@ public:
                         if (q_.empty())
                             return makePollReady(Optional<Item>());
                         try {
-                            return makePollReady(Optional<Item>(codec_->decodeEof(q_)));
+                            auto v = codec_->decodeEof(q_);
+                            setBuffered(q_.chainLength());
+                            return makePollReady(Optional<Item>(std::move(v)));
                         } catch (std::exception &e) {
                             return Poll<Optional<Item>>(
                                 folly::exception_wrapper(std::current_exception(), e));
@@ -78,6 +146,7 @@ public:
                     } else {
                         try {
                             auto f = codec_->decode(q_);
+                            setBuffered(q_.chainLength());
                             if (f.hasValue()) {
                                 return makePollReady(std::move(f));
                             } else {
@@ -106,6 +175,12 @@ public:
         : io_(io), codec_(decoder) {
     }
 
+    FramedStream(Channel::Ptr io, std::shared_ptr<codec::DecoderBase<T>> decoder,
+            const ReadPolicy &policy)
+        : io_(io), codec_(decoder) {
+        io_->setReadPolicy(policy);
+    }
+
     Poll<Optional<Item>> poll() override {
         if (!tok_)
             tok_ = io_->doRead(folly::make_unique<FramedStreamReader>(codec_));
@@ -124,31 +199,60 @@ public:
     using Out = T;
 
     FramedSink(Channel::Ptr io, std::shared_ptr<codec::EncoderBase<T>> encoder)
-        : io_(std::move(io)), codec_(encoder) {
+        : io_(std::move(io)), codec_(encoder),
+          q_(folly::IOBufQueue::cacheChainLength()) {
+    }
+
+    FramedSink(FramedSink&&) = default;
+
+    ~FramedSink() {
+        if (io_)
+            io_->chargeMemory(-(ssize_t)q_.chainLength());
     }
 
     Try<void> startSend(Out&& item) override {
+        size_t before = q_.chainLength();
         try {
             codec_->encode(std::move(item), q_);
+            io_->chargeMemory(q_.chainLength() - before);
             return Try<void>();
         } catch (std::exception &e) {
+            io_->chargeMemory(q_.chainLength() - before);
             return Try<void>(folly::exception_wrapper(std::current_exception(), e));
         }
     }
 
-    Poll<Unit> pollComplete() override {
-        if (!write_req_) {
-            if (q_.empty()) return makePollReady(folly::unit);
-            write_req_ = io_->doWrite(folly::make_unique<WriterCompletionToken>(q_.move()));
+    // Encoded frames count against the channel's write watermarks, above
+    // the high one they are handed to the channel and the task waits for
+    // it to drain.
+    Poll<Unit> pollReady() override {
+        size_t high = io_->getWriteHighWatermark();
+        if (high && q_.chainLength() + io_->getWriteBuffered() >= high)
+            startWrite();
+        // surface errors of the writes already done
+        while (!writes_.empty()
+                && writes_.front()->getState() != CompletionToken::STARTED) {
+            auto r = writes_.front()->poll();
+            if (r.hasException())
+                return Poll<Unit>(r.exception());
+            writes_.pop_front();
         }
-        auto r = write_req_->poll();
-        if (r.hasException())
-            return Poll<Unit>(r.exception());
-        if (r->hasValue()) {
-            write_req_.reset();
-            return makePollReady(unit);
+        return io_->pollWritable();
+    }
+
+    Poll<Unit> pollComplete() override {
+        // frames encoded while earlier writes are in flight are queued
+        // behind them
+        startWrite();
+        while (!writes_.empty()) {
+            auto r = writes_.front()->poll();
+            if (r.hasException())
+                return Poll<Unit>(r.exception());
+            if (!r->hasValue())
+                return Poll<Unit>(not_ready);
+            writes_.pop_front();
         }
-        return Poll<Unit>(not_ready);
+        return makePollReady(folly::unit);
     }
 
 private:
@@ -156,7 +260,17 @@ private:
     std::shared_ptr<codec::EncoderBase<T>> codec_;
     folly::IOBufQueue q_;
 
-    intrusive_ptr<WriterCompletionToken> write_req_;
+    std::deque<intrusive_ptr<WriterCompletionToken>> writes_;
+
+    void startWrite() {
+        if (q_.empty())
+            return;
+        // counted by the channel as a buffered write from here on
+        ssize_t encoded = q_.chainLength();
+        writes_.push_back(io_->doWrite(
+                    folly::make_unique<WriterCompletionToken>(q_.move())));
+        io_->chargeMemory(-encoded);
+    }
 };
 
 class TransferAtLeast {
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <futures/core/IOBuf.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <memory>
+
+namespace futures {
+namespace io {
+
+// Read-only mapping of a file range. Buffers handed out by buffer() point
+// straight into the mapping and keep it alive, it is unmapped when the
+// last of them and the MappedFile itself are gone. The fd may be closed
+// once the file is mapped.
+//
+// Contents follow the file, so truncating it while mapped raises SIGBUS
+// on access. Intended for read-mostly data such as static assets.
+class MappedFile : public std::enable_shared_from_this<MappedFile> {
+public:
+    using Ptr = std::shared_ptr<MappedFile>;
+
+    // Maps `length' bytes from `offset', -1 up to the end of file. With
+    // `populate' the pages are faulted in (MAP_POPULATE) before returning,
+    // so later reads don't block on the disk. Throws std::system_error.
+    static Ptr map(int fd, off_t offset = 0, size_t length = -1,
+            bool populate = false);
+
+    MappedFile(void *base, size_t mapped, size_t skip, size_t length);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return length_; }
+
+    // madvise(2) on a range of the mapping, e.g. MADV_SEQUENTIAL,
+    // MADV_RANDOM, MADV_WILLNEED or MADV_DONTNEED
+    void advise(int advice, size_t offset = 0, size_t length = -1);
+
+    // Zero copy view of [offset, offset + length), clamped to the mapping.
+    // The pages are read-only, the buffer must not be written.
+    std::unique_ptr<folly::IOBuf> buffer(size_t offset = 0,
+            size_t length = -1);
+
+private:
+    void *base_;
+    size_t mapped_;
+    const uint8_t *data_;
+    size_t length_;
+
+    static void release(void *buf, void *userData);
+};
+
+}
+}
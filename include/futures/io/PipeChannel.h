@@ -59,7 +59,7 @@ private:
 
     void onEvent(ev::io& watcher, int revent);
     ssize_t handleRead(ReaderCompletionToken *tok, std::error_code &ec);
-    void handleWrite() {}
+    void handleWrite();
     ssize_t performRead(void* buf, size_t buflen, std::error_code &ec);
     ssize_t performWrite(
             const iovec* vec,
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <futures/io/AsyncSocket.h>
+#include <futures/io/FdWatcher.h>
+
+namespace futures {
+namespace io {
+
+struct ProxyStats {
+    // bytes relayed from the first channel to the second, and back
+    uint64_t forward = 0;
+    uint64_t backward = 0;
+    // through splice(2) instead of buffers
+    bool spliced = false;
+};
+
+// L4 relay between two connected channels. Each direction runs until its
+// source reaches EOF, which is passed on with shutdownWrite(), so
+// half-closed connections keep working. The proxy completes once both
+// directions are done and fails with the first error of either.
+//
+// Plain sockets are relayed with splice(2) through a pipe per direction,
+// the bytes never enter user space. A direction stops reading while its
+// pipe cannot be drained into the destination. TLS channels, and any
+// system without splice(2), copy through buffers with a write in flight
+// per direction instead.
+//
+// Neither channel may have reads in flight, and writes queued on them
+// must complete first. Spliced bytes bypass the channels, so their
+// timeouts and watermarks don't see them.
+class Proxy : public IOObject,
+    public std::enable_shared_from_this<Proxy> {
+public:
+    using Ptr = std::shared_ptr<Proxy>;
+
+    // capacity of each pipe, the most one direction buffers
+    static const size_t kPipeSize = 64 * 1024;
+
+    Proxy(EventExecutor *ev, SocketChannel::Ptr a, SocketChannel::Ptr b,
+            size_t pipe_size = kPipeSize);
+    ~Proxy();
+
+    BoxedFuture<ProxyStats> run();
+
+    // live counters
+    ProxyStats getStats() const;
+
+    void onCancel(CancelReason reason) override;
+
+private:
+    struct Direction {
+        Proxy *proxy;
+        SocketChannel::Ptr from;
+        SocketChannel::Ptr to;
+        FdWatcher rio;
+        FdWatcher wio;
+        int pipe[2] = {-1, -1};
+        // spliced into the pipe, not out yet
+        size_t pending = 0;
+        uint64_t bytes = 0;
+        bool eof = false;
+        bool done = false;
+
+        Direction(Proxy *proxy, SocketChannel::Ptr from, SocketChannel::Ptr to);
+
+        void onEvent(ev::io &w, int revents) {
+            proxy->pump(*this);
+        }
+    };
+
+    struct SpliceToken : public CompletionToken {
+        Proxy *proxy;
+        ProxyStats stats;
+        folly::exception_wrapper error;
+
+        explicit SpliceToken(Proxy *proxy)
+            : CompletionToken(IOObject::OpRead), proxy(proxy) {
+        }
+
+        void onCancel(CancelReason r) override {
+            proxy->stopSplice();
+        }
+
+        Poll<ProxyStats> poll() {
+            switch (getState()) {
+            case STARTED:
+                park();
+                return Poll<ProxyStats>(not_ready);
+            case DONE:
+                if (error)
+                    return Poll<ProxyStats>(error);
+                return makePollReady(stats);
+            case CANCELLED:
+                return Poll<ProxyStats>(FutureCancelledException());
+            default:
+                throw InvalidPollStateException();
+            }
+        }
+
+    protected:
+        ~SpliceToken() {
+            cleanup(CancelReason::UserCancel);
+        }
+    };
+
+    class SpliceFuture : public FutureBase<SpliceFuture, ProxyStats> {
+    public:
+        using Item = ProxyStats;
+
+        explicit SpliceFuture(Ptr proxy) : proxy_(std::move(proxy)) {}
+
+        Poll<Item> poll() override {
+            if (!tok_)
+                tok_ = proxy_->startSplice();
+            return tok_->poll();
+        }
+
+    private:
+        Ptr proxy_;
+        intrusive_ptr<SpliceToken> tok_;
+    };
+
+    size_t pipe_size_;
+    Direction fwd_;
+    Direction bwd_;
+    bool spliced_ = false;
+    SpliceToken *tok_ = nullptr;
+
+    bool openPipes();
+    void closePipes();
+    intrusive_ptr<SpliceToken> startSplice();
+    void stopSplice();
+    void pump(Direction &d);
+    void finish(folly::exception_wrapper error);
+    BoxedFuture<Unit> copy(Direction &d);
+};
+
+inline BoxedFuture<ProxyStats> proxy(EventExecutor *ev,
+        SocketChannel::Ptr a, SocketChannel::Ptr b) {
+    return std::make_shared<Proxy>(ev, std::move(a), std::move(b))->run();
+}
+
+}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace futures {
+namespace io {
+
+struct ReadPolicy {
+    // bounds of the adaptive size of the reader's own buffers in scatter
+    // reads, max_read also sizes the executor's shared read buffer
+    size_t min_read = 64;
+    size_t initial_read = 2048;
+    size_t max_read = 64 * 1024;
+    // per readiness event, so one busy connection cannot starve the others
+    // on the same loop
+    size_t max_bytes_per_event = 256 * 1024;
+    size_t max_reads_per_event = 16;
+};
+
+// Picks the size of the next read from recent read results, like netty's
+// AdaptiveRecvByteBufAllocator: grow as soon as a read fills the buffer,
+// shrink only after two consecutive reads that would fit in half of it.
+class AdaptiveReadSizer {
+public:
+    explicit AdaptiveReadSizer(const ReadPolicy &policy = ReadPolicy()) {
+        reset(policy);
+    }
+
+    void reset(const ReadPolicy &policy) {
+        min_ = std::max<size_t>(policy.min_read, 1);
+        max_ = std::max(policy.max_read, min_);
+        size_ = std::min(std::max(policy.initial_read, min_), max_);
+        decrease_now_ = false;
+    }
+
+    size_t next() const { return size_; }
+
+    void record(size_t attempted, size_t actual) {
+        if (actual >= attempted) {
+            size_ = std::min(size_ * 4, max_);
+            decrease_now_ = false;
+        } else if (actual <= size_ / 2) {
+            if (decrease_now_) {
+                size_ = std::max(size_ / 2, min_);
+                decrease_now_ = false;
+            } else {
+                decrease_now_ = true;
+            }
+        } else {
+            decrease_now_ = false;
+        }
+    }
+
+private:
+    size_t min_;
+    size_t max_;
+    size_t size_;
+    bool decrease_now_;
+};
+
+}
+}
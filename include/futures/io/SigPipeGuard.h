@@ -0,0 +1,42 @@
+#pragma once
+
+#include <csignal>
+#include <cerrno>
+#include <ctime>
+
+namespace futures {
+namespace io {
+
+// Blocks SIGPIPE on this thread while in scope, for writes that have no
+// MSG_NOSIGNAL such as sendfile(2) and splice(2). A SIGPIPE raised
+// meanwhile is discarded, unless it was blocked already.
+class SigPipeGuard {
+public:
+    SigPipeGuard() {
+        sigemptyset(&pipe_set_);
+        sigaddset(&pipe_set_, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipe_set_, &old_set_);
+    }
+
+    ~SigPipeGuard() {
+        int err = errno;
+        sigset_t pending;
+        if (!sigismember(&old_set_, SIGPIPE)
+                && sigpending(&pending) == 0 && sigismember(&pending, SIGPIPE)) {
+            struct timespec zero = {0, 0};
+            ::sigtimedwait(&pipe_set_, nullptr, &zero);
+        }
+        pthread_sigmask(SIG_SETMASK, &old_set_, nullptr);
+        errno = err;
+    }
+
+    SigPipeGuard(const SigPipeGuard&) = delete;
+    SigPipeGuard& operator=(const SigPipeGuard&) = delete;
+
+private:
+    sigset_t pipe_set_;
+    sigset_t old_set_;
+};
+
+}
+}
@@ -0,0 +1,387 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <futures/Future.h>
+#include <futures/EventExecutor.h>
+#include <futures/io/WaitHandleBase.h>
+#include <futures/core/SocketAddress.h>
+
+namespace futures {
+namespace service {
+
+template <typename Conn, typename Key>
+class ConnectionPool;
+
+// A connection checked out of a ConnectionPool, returned to it when the
+// lease is destroyed unless discard() was called.
+template <typename Conn, typename Key = folly::SocketAddress>
+class PoolLease {
+public:
+    using Pool = ConnectionPool<Conn, Key>;
+    using ConnPtr = std::shared_ptr<Conn>;
+
+    PoolLease() = default;
+
+    PoolLease(std::shared_ptr<Pool> pool, const Key &key, ConnPtr conn)
+        : pool_(std::move(pool)), key_(key), conn_(std::move(conn)) {
+    }
+
+    PoolLease(PoolLease &&o) noexcept
+        : pool_(std::move(o.pool_)), key_(std::move(o.key_)),
+          conn_(std::move(o.conn_)), reusable_(o.reusable_) {
+    }
+
+    PoolLease &operator=(PoolLease &&o) noexcept {
+        if (this != &o) {
+            release();
+            pool_ = std::move(o.pool_);
+            key_ = std::move(o.key_);
+            conn_ = std::move(o.conn_);
+            reusable_ = o.reusable_;
+        }
+        return *this;
+    }
+
+    ~PoolLease() {
+        release();
+    }
+
+    Conn *operator->() const { return conn_.get(); }
+    Conn &operator*() const { return *conn_; }
+    const ConnPtr &get() const { return conn_; }
+    const Key &getKey() const { return key_; }
+    explicit operator bool() const { return (bool)conn_; }
+
+    // close instead of reusing, e.g. after a protocol error
+    void discard() { reusable_ = false; }
+
+    void release() {
+        if (!conn_)
+            return;
+        if (auto pool = pool_.lock())
+            pool->putBack(key_, std::move(conn_), reusable_);
+        conn_.reset();
+        pool_.reset();
+    }
+
+private:
+    std::weak_ptr<Pool> pool_;
+    Key key_;
+    ConnPtr conn_;
+    bool reusable_ = true;
+};
+
+// Executor-local pool of connections keyed by endpoint. At most
+// `max_per_key' connections exist per key (idle, leased or connecting),
+// callers beyond that wait in FIFO order for one to be returned. Idle
+// connections are checked with the health check on checkout and reaped
+// after `idle_timeout' on the executor's DeadlineQueue. Connections the
+// pool drops go to the closer, if any, and are released otherwise.
+//
+// No locking, only use it from the executor's thread.
+template <typename Conn, typename Key = folly::SocketAddress>
+class ConnectionPool
+    : public io::IOObject,
+      public std::enable_shared_from_this<ConnectionPool<Conn, Key>> {
+public:
+    using Ptr = std::shared_ptr<ConnectionPool>;
+    using ConnPtr = std::shared_ptr<Conn>;
+    using Lease = PoolLease<Conn, Key>;
+    using Factory = std::function<BoxedFuture<ConnPtr>(const Key&)>;
+    // false drops the connection, e.g. a channel that is no longer good()
+    using HealthCheck = std::function<bool(Conn&)>;
+    // e.g. a graceful shutdown of the protocol
+    using Closer = std::function<void(ConnPtr)>;
+
+    struct Options {
+        size_t max_per_key;
+        // returned connections beyond this many idle ones are dropped,
+        // only max_per_key limits them by default
+        size_t max_idle_per_key;
+        // seconds, 0 keeps idle connections forever
+        double idle_timeout;
+
+        Options() : max_per_key(8), max_idle_per_key(-1), idle_timeout(60.0) {}
+    };
+
+    ConnectionPool(EventExecutor *ev, Factory factory,
+            const Options &opts = Options(), HealthCheck check = HealthCheck())
+        : io::IOObject(ev), factory_(std::move(factory)), opts_(opts),
+          check_(std::move(check)), reaper_(this) {
+        assert(opts_.max_per_key > 0);
+    }
+
+    ~ConnectionPool() {
+        getExecutor()->getDeadlines().cancel(&reaper_);
+    }
+
+    struct CheckoutToken : public io::CompletionToken {
+        Optional<Lease> lease;
+        folly::exception_wrapper error;
+
+        CheckoutToken()
+            : io::CompletionToken(IOObject::OpRead) {
+        }
+
+        void onCancel(CancelReason r) override {
+        }
+
+        Poll<Lease> poll() {
+            switch (getState()) {
+            case STARTED:
+                park();
+                return Poll<Lease>(not_ready);
+            case DONE:
+                if (error)
+                    return Poll<Lease>(error);
+                return makePollReady(std::move(lease).value());
+            case CANCELLED:
+                return Poll<Lease>(FutureCancelledException());
+            default:
+                throw InvalidPollStateException();
+            }
+        }
+
+    protected:
+        ~CheckoutToken() {
+            cleanup(CancelReason::UserCancel);
+        }
+    };
+
+    using TokenPtr = io::intrusive_ptr<CheckoutToken>;
+
+    class CheckoutFuture : public FutureBase<CheckoutFuture, Lease> {
+    public:
+        using Item = Lease;
+
+        CheckoutFuture(Ptr pool, const Key &key)
+            : pool_(std::move(pool)), key_(key) {}
+
+        CheckoutFuture(CheckoutFuture&&) = default;
+        CheckoutFuture& operator=(CheckoutFuture&&) = default;
+
+        // a dropped checkout, e.g. timed out, stops waiting for a lease
+        ~CheckoutFuture() {
+            if (tok_)
+                tok_->cleanup(CancelReason::UserCancel);
+        }
+
+        Poll<Item> poll() override {
+            if (!tok_)
+                tok_ = pool_->doCheckout(key_);
+            return tok_->poll();
+        }
+
+    private:
+        Ptr pool_;
+        Key key_;
+        TokenPtr tok_;
+    };
+
+    CheckoutFuture checkout(const Key &key) {
+        return CheckoutFuture(this->shared_from_this(), key);
+    }
+
+    TokenPtr doCheckout(const Key &key) {
+        TokenPtr tok(new CheckoutToken());
+        tok->attach(this);
+        auto &b = buckets_[key];
+        b.waiters.push_back(tok);
+        dispatch(key, b);
+        return tok;
+    }
+
+    // open connections in the background until `key' has `n' (at most
+    // max_per_key), they wait idle for the first checkouts
+    void prewarm(const Key &key, size_t n) {
+        auto &b = buckets_[key];
+        n = std::min(n, opts_.max_per_key);
+        while (b.total() < n)
+            connect(key, b);
+    }
+
+    size_t getIdleCount(const Key &key) const {
+        auto it = buckets_.find(key);
+        return it == buckets_.end() ? 0 : it->second.idle.size();
+    }
+
+    size_t getLeasedCount(const Key &key) const {
+        auto it = buckets_.find(key);
+        return it == buckets_.end() ? 0 : it->second.leased;
+    }
+
+    // idle, leased and connecting
+    size_t getCount(const Key &key) const {
+        auto it = buckets_.find(key);
+        return it == buckets_.end() ? 0 : it->second.total();
+    }
+
+    uint64_t getConnects() const { return connects_; }
+
+    void setCloser(Closer closer) { closer_ = std::move(closer); }
+
+    void onCancel(CancelReason reason) override {
+    }
+
+private:
+    struct IdleConn {
+        ConnPtr conn;
+        double since;
+    };
+
+    struct Bucket {
+        // oldest first, checkouts take the most recently used
+        std::deque<IdleConn> idle;
+        size_t leased = 0;
+        size_t connecting = 0;
+        std::deque<TokenPtr> waiters;
+
+        size_t total() const {
+            return idle.size() + leased + connecting;
+        }
+    };
+
+    struct Reaper : public DeadlineQueue::Entry {
+        ConnectionPool *pool;
+
+        explicit Reaper(ConnectionPool *pool) : pool(pool) {}
+
+        void onDeadline() override {
+            pool->reapIdle();
+        }
+    };
+
+    Factory factory_;
+    Options opts_;
+    HealthCheck check_;
+    Closer closer_;
+    std::unordered_map<Key, Bucket> buckets_;
+    Reaper reaper_;
+    uint64_t connects_ = 0;
+
+    friend class PoolLease<Conn, Key>;
+
+    static bool waiting(TokenPtr &tok) {
+        return tok->getState() == io::CompletionToken::STARTED;
+    }
+
+    // serve the waiters of `key' from idle connections, then from new ones
+    void dispatch(const Key &key, Bucket &b) {
+        b.waiters.erase(std::remove_if(b.waiters.begin(), b.waiters.end(),
+                    [] (TokenPtr &tok) { return !waiting(tok); }),
+                b.waiters.end());
+        while (!b.waiters.empty()) {
+            auto tok = b.waiters.front();
+            if (!waiting(tok)) {
+                b.waiters.pop_front();
+                continue;
+            }
+            if (b.idle.empty())
+                break;
+            auto conn = std::move(b.idle.back().conn);
+            b.idle.pop_back();
+            if (check_ && !check_(*conn)) {
+                drop(std::move(conn));
+                continue;
+            }
+            b.waiters.pop_front();
+            b.leased++;
+            tok->lease.emplace(this->shared_from_this(), key, std::move(conn));
+            tok->notifyDone();
+        }
+        size_t live = 0;
+        for (auto &tok : b.waiters)
+            if (waiting(tok))
+                live++;
+        while (live > b.connecting && b.total() < opts_.max_per_key)
+            connect(key, b);
+    }
+
+    void connect(const Key &key, Bucket &b) {
+        b.connecting++;
+        connects_++;
+        auto self = this->shared_from_this();
+        getExecutor()->spawn(startConnect(key)
+            .then([self, key] (Try<ConnPtr> r) {
+                auto &b = self->buckets_[key];
+                b.connecting--;
+                if (r.hasException()) {
+                    // fail one waiter, the others get another attempt
+                    while (!b.waiters.empty()) {
+                        auto tok = b.waiters.front();
+                        b.waiters.pop_front();
+                        if (waiting(tok)) {
+                            tok->error = r.exception();
+                            tok->notifyDone();
+                            break;
+                        }
+                    }
+                } else {
+                    b.idle.push_back(IdleConn{std::move(r).value(),
+                            self->getExecutor()->getNow()});
+                    self->scheduleReap();
+                }
+                self->dispatch(key, b);
+                return makeOk();
+            }));
+    }
+
+    BoxedFuture<ConnPtr> startConnect(const Key &key) {
+        try {
+            return factory_(key);
+        } catch (std::exception &e) {
+            return makeErr<ConnPtr>(folly::exception_wrapper(
+                        std::current_exception(), e)).boxed();
+        }
+    }
+
+    void putBack(const Key &key, ConnPtr conn, bool reusable) {
+        auto &b = buckets_[key];
+        b.leased--;
+        if (reusable && b.idle.size() < opts_.max_idle_per_key
+                && (!check_ || check_(*conn))) {
+            b.idle.push_back(IdleConn{std::move(conn), getExecutor()->getNow()});
+            scheduleReap();
+        } else {
+            drop(std::move(conn));
+        }
+        dispatch(key, b);
+    }
+
+    void drop(ConnPtr conn) {
+        if (closer_)
+            closer_(std::move(conn));
+    }
+
+    void scheduleReap() {
+        if (opts_.idle_timeout <= 0 || reaper_.isArmed())
+            return;
+        double oldest = 0;
+        for (auto &e : buckets_)
+            if (!e.second.idle.empty()
+                    && (oldest == 0 || e.second.idle.front().since < oldest))
+                oldest = e.second.idle.front().since;
+        if (oldest > 0)
+            getExecutor()->getDeadlines().schedule(&reaper_,
+                    oldest + opts_.idle_timeout);
+    }
+
+    void reapIdle() {
+        double expire = getExecutor()->getNow() - opts_.idle_timeout;
+        for (auto &e : buckets_) {
+            auto &idle = e.second.idle;
+            while (!idle.empty() && idle.front().since <= expire) {
+                auto conn = std::move(idle.front().conn);
+                idle.pop_front();
+                drop(std::move(conn));
+            }
+        }
+        scheduleReap();
+    }
+};
+
+}
+}
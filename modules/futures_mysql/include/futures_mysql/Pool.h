@@ -1,14 +1,17 @@
 #pragma once
 
 #include <string>
-#include <deque>
 #include <memory>
 #include <futures/Future.h>
+#include <futures/service/ConnectionPool.h>
 #include <futures_mysql/Connection.h>
 
 namespace futures {
 namespace mysql {
 
+// Idle connections to one server, on ConnectionPool. A connection from
+// getConnection() goes back to the pool once it and all its copies are
+// gone, if it is still idle and saw no errors, otherwise it is closed.
 class Pool : public io::IOObject {
 public:
   using Ptr = std::shared_ptr<Pool>;
@@ -22,30 +25,40 @@ public:
       double max_idle_time = 0)
     : io::IOObject(ev), config_(c),
       max_idles_(max_idle), max_idle_time_(max_idle_time),
-      timer_(ev->getLoop())
+      key_(c.host + ":" + std::to_string(c.port))
   {
-    timer_.set<Pool, &Pool::onTimer>(this);
-    if (max_idle_time_ > 0) {
-      double sleep = max_idle_time_ * 0.5;
-      timer_.start(sleep, sleep);
-    }
+    ConnPool::Options opts;
+    // no limit on connections in use, as before
+    opts.max_per_key = -1;
+    opts.max_idle_per_key = max_idles_;
+    opts.idle_timeout = max_idle_time_;
+    pool_ = std::make_shared<ConnPool>(ev,
+        [ev, c] (const std::string&) {
+          return Connection::connect(ev, c).boxed();
+        }, opts,
+        [] (Connection &conn) {
+          // only reuse GOOD connections
+          return conn.isIdle() && !conn.getErrors();
+        });
+    pool_->setCloser([ev] (Connection::Ptr conn) {
+      if (conn->isIdle())
+        ev->spawn(conn->close());
+    });
   }
 
   BoxedFuture<Connection::Ptr> getConnection() {
-    if (conns_.size()) {
-      auto p = conns_.back();
-      conns_.pop_back();
-      return makeOk(std::move(p)).boxed();
-    } else {
-      return Connection::connect(getExecutor(), config_).boxed();
-    }
+    return (pool_->checkout(key_)
+      | [] (ConnPool::Lease lease) {
+        // returns the lease with the last copy of the connection
+        auto holder = std::make_shared<ConnPool::Lease>(std::move(lease));
+        return Connection::Ptr(holder, holder->get().get());
+      }).boxed();
   }
 
   BoxedFuture<folly::Unit> checkin(Connection::Ptr conn) {
     if (conn->isIdle()) {
       // only reuse GOOD connections
-      if (conns_.size() < max_idles_ && !conn->getErrors()) {
-        conns_.push_back(conn);
+      if (pool_->getIdleCount(key_) < max_idles_ && !conn->getErrors()) {
         return makeOk().boxed();
       } else {
         return conn->close().boxed();
@@ -57,46 +70,22 @@ public:
   }
 
   void onCancel(CancelReason r) override {
-    timer_.stop();
   }
 
   size_t getMaxIdles() const { return max_idles_; }
-  size_t getIdleCount() const { return conns_.size(); }
+  size_t getIdleCount() const { return pool_->getIdleCount(key_); }
 
   Pool(const Pool&) = delete;
   Pool& operator=(const Pool&) = delete;
 private:
+  using ConnPool = service::ConnectionPool<Connection, std::string>;
+
   const Config config_;
   const size_t max_idles_;
   const double max_idle_time_;
-  std::deque<Connection::Ptr> conns_;
-  ev::timer timer_;
-
-  void reapConnections() {
-    if (conns_.empty()) return;
-    if (max_idle_time_ <= 0) return;
-    auto now = getExecutor()->getNow();
-    size_t reaped = 0;
-    for (auto it = conns_.begin(); it != conns_.end();) {
-      if ((*it)->getLastUsedTimestamp() + max_idle_time_ <= now) {
-        auto p = *it;
-        it = conns_.erase(it);
-        getExecutor()->spawn(p->close());
-        reaped++;
-      } else {
-        ++it;
-      }
-    }
-    if (reaped)
-      FUTURES_DLOG(INFO) << "reaped connections: " << reaped;
-  }
-
-  void onTimer(ev::timer &timer, int revent) {
-    if (revent & ev::TIMER)
-      reapConnections();
-  }
+  const std::string key_;
+  ConnPool::Ptr pool_;
 };
 
-
 }
 }
@@ -5,6 +5,7 @@
 #include <futures/Stream.h>
 #include <futures/EventExecutor.h>
 #include <futures/io/WaitHandleBase.h>
+#include <futures/dns/Resolver.h>
 #include <futures_redis/RedisReply.h>
 
 struct redisAsyncContext;
@@ -30,6 +31,13 @@ public:
     AsyncContext(EventExecutor *loop, const std::string& addr, uint16_t port);
     ~AsyncContext();
 
+    // Resolves `host' and races its addresses with Happy Eyeballs instead
+    // of the blocking connect on the first command. Reconnects go to the
+    // address that won.
+    static BoxedFuture<Ptr> connect(EventExecutor *loop,
+            dns::AsyncResolver::Ptr resolver, const std::string &host,
+            uint16_t port);
+
     AsyncContext &operator=(const AsyncContext&) = delete;
     AsyncContext(const AsyncContext&) = delete;
 
@@ -129,6 +137,8 @@ private:
     void redisWriteEvent(ev::io &watcher, int revent);
 
     void reconnect();
+    void adopt(int fd);
+    void setup();
     void reconnectIfNeeded() {
         if (!connected_ || !c_) reconnect();
     }
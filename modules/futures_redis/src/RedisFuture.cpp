@@ -1,4 +1,7 @@
 #include <futures_redis/RedisFuture.h>
+#include <futures/io/HappyEyeballs.h>
+#include <futures/dns/ResolverFuture.h>
+#include <fcntl.h>
 #include "hiredis/async.h"
 #include "hiredis/hiredis.h"
 
@@ -23,10 +26,45 @@ void AsyncContext::reconnect() {
     }
     FUTURES_DLOG(INFO) << "reconnecting to redis";
     c_ = redisAsyncConnect(addr_.c_str(), port_);
+    setup();
+    connected_ = false;
+}
+
+BoxedFuture<AsyncContext::Ptr> AsyncContext::connect(EventExecutor *loop,
+        dns::AsyncResolver::Ptr resolver, const std::string &host,
+        uint16_t port) {
+    BoxedFuture<dns::ResolverResult> addrs = folly::IPAddress::validate(host)
+        ? makeOk(dns::ResolverResult{folly::IPAddress(host)}).boxed()
+        : resolver->resolve(host,
+                dns::AsyncResolver::EnableTypeA4 | dns::AsyncResolver::EnableTypeA6)
+            .boxed();
+    return (std::move(addrs)
+        >> [loop, port] (dns::ResolverResult addrs) {
+            return io::connectHappyEyeballs(loop, addrs, port);
+        }
+        | [loop, port] (io::SocketChannel::Ptr sock) {
+            auto ctx = std::make_shared<AsyncContext>(loop,
+                    sock->getPeerAddress().getAddressStr(), port);
+            // the channel closes its own descriptor once dropped
+            ctx->adopt(::fcntl(sock->fd(), F_DUPFD_CLOEXEC, 0));
+            return ctx;
+        }).boxed();
+}
+
+void AsyncContext::adopt(int fd) {
+    if (fd < 0)
+        throw RedisException(std::string("dup: ") + strerror(errno));
+    c_ = redisAsyncConnectFd(fd);
+    setup();
+    connected_ = true;
+}
+
+void AsyncContext::setup() {
     if (!c_) throw RedisException("redisAsyncContext");
     if (c_->err) {
             std::string err(c_->errstr);
             redisAsyncFree(c_);
+            c_ = nullptr;
             throw RedisException(err);
     }
     c_->ev.addRead = redisAddRead;
@@ -39,7 +77,6 @@ void AsyncContext::reconnect() {
 
     reading_ = false;
     writing_ = false;
-    connected_ = false;
 
     rev_.set<AsyncContext, &AsyncContext::redisReadEvent>(this);
     rev_.set(c_->c.fd, ev::READ);
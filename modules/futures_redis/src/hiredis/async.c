@@ -184,6 +184,28 @@ redisAsyncContext *redisAsyncConnectBindWithReuse(const char *ip, int port,
     return ac;
 }
 
+/* Takes over `fd', a socket connected and made non-blocking by the caller,
+ * it is closed on failure. */
+redisAsyncContext *redisAsyncConnectFd(int fd) {
+    redisContext *c;
+    redisAsyncContext *ac;
+
+    c = redisConnectFd(fd);
+    if (c == NULL)
+        return NULL;
+    c->flags &= ~REDIS_BLOCK;
+
+    ac = redisAsyncInitialize(c);
+    if (ac == NULL) {
+        redisFree(c);
+        return NULL;
+    }
+
+    /* Nothing to wait for, the connect callback is not called. */
+    ac->c.flags |= REDIS_CONNECTED;
+    return ac;
+}
+
 redisAsyncContext *redisAsyncConnectUnix(const char *path) {
     redisContext *c;
     redisAsyncContext *ac;
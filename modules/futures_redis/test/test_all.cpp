@@ -2,6 +2,8 @@
 #include <gtest/gtest.h>
 #include <futures_redis/RedisFuture.h>
 #include <futures/Timer.h>
+#include <futures/io/AsyncSocket.h>
+#include <futures/io/AsyncServerSocket.h>
 
 using namespace futures;
 
@@ -29,6 +31,38 @@ TEST(Futures, Redis) {
 }
 #endif
 
+TEST(Futures, RedisConnect) {
+	EventExecutor loop;
+	auto server = std::make_shared<io::AsyncServerSocket>(&loop,
+			folly::SocketAddress("127.0.0.1", 0));
+	// answers every read with a status reply
+	loop.spawn(server->accept().take(1)
+		.forEach2([&loop] (tcp::Socket s, folly::SocketAddress peer) {
+			auto sock = std::make_shared<io::SocketChannel>(&loop, std::move(s), peer);
+			loop.spawn(sock->readStream()
+				.andThen([sock] (std::unique_ptr<folly::IOBuf> buf) {
+					return sock->write(folly::IOBuf::copyBuffer("+PONG\r\n", 7));
+				})
+				.drop()
+				.error([] (folly::exception_wrapper w) {}));
+		}));
+
+	std::string status;
+	loop.spawn(redis_io::AsyncContext::connect(&loop, nullptr, "127.0.0.1",
+				server->getLocalAddress().getPort())
+		>> [&] (redis_io::AsyncContext::Ptr redis) {
+			EXPECT_TRUE(redis->isConnected());
+			return redis->execute("PING")
+				>> [&, redis] (redis_io::Reply r) {
+					status = r.str();
+					loop.stop();
+					return makeOk();
+				};
+		});
+	loop.run();
+	EXPECT_EQ(status, "PONG");
+}
+
 int main(int argc, char* argv[]) {
 	testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
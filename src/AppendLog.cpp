@@ -0,0 +1,133 @@
+#include <futures/io/AppendLog.h>
+#include <futures/core/IOBufQueue.h>
+#include <sys/stat.h>
+
+namespace futures {
+namespace io {
+
+// a short write continues after the bytes that made it, only an error or
+// a write making no progress fails
+static BoxedFuture<Unit> writeAll(AsyncFile::Ptr file, off_t offset,
+        std::unique_ptr<folly::IOBuf> chain) {
+    auto q = std::make_shared<folly::IOBufQueue>(
+            folly::IOBufQueue::cacheChainLength());
+    q->append(std::move(chain));
+    return makeLoop(off_t(offset), [file, q] (off_t at) {
+        return file->pwrite(at, q->front()->clone())
+            >> [q, at] (ssize_t n) {
+                if (n <= 0)
+                    throw std::system_error(EIO, std::system_category(), "pwritev");
+                q->trimStart(n);
+                if (q->empty())
+                    return makeOk(makeBreak<Unit, off_t>(unit));
+                return makeOk(makeContinue<Unit, off_t>(at + n));
+            };
+    }).boxed();
+}
+
+AppendLog::AppendLog(EventExecutor *ev, AsyncFile::Ptr file,
+        const Options &opts)
+    : ev_(ev), file_(std::move(file)), opts_(opts), timer_(ev->getLoop()) {
+    struct stat st;
+    if (::fstat(file_->fd(), &st) < 0)
+        throw std::system_error(errno, std::system_category(), "fstat");
+    end_ = durable_ = st.st_size;
+    timer_.set<AppendLog, &AppendLog::onTimer>(this);
+}
+
+AppendLog::~AppendLog() {
+    timer_.stop();
+}
+
+BoxedFuture<off_t> AppendLog::append(std::unique_ptr<folly::IOBuf> record) {
+    if (error_)
+        return PromiseFuture<off_t>(Try<off_t>(error_)).boxed();
+    Entry e;
+    e.buf = std::move(record);
+    auto f = e.promise.getFuture();
+    pending_bytes_ += e.buf->computeChainDataLength();
+    pending_.push_back(std::move(e));
+    if (pending_.size() == 1 && opts_.max_latency > 0) {
+        // the window starts with the first record of the batch
+        timer_.set(opts_.max_latency);
+        timer_.start();
+    }
+    maybeCommit();
+    return f.boxed();
+}
+
+void AppendLog::maybeCommit() {
+    if (committing_ || pending_.empty())
+        return;
+    if (expired_ || opts_.max_latency <= 0
+            || pending_.size() >= opts_.max_records
+            || pending_bytes_ >= opts_.max_bytes)
+        commit();
+}
+
+void AppendLog::onTimer(ev::timer &w, int revents) {
+    expired_ = true;
+    maybeCommit();
+}
+
+void AppendLog::commit() {
+    timer_.stop();
+    expired_ = false;
+
+    std::unique_ptr<folly::IOBuf> chain;
+    auto batch = std::make_shared<std::vector<std::pair<off_t, Promise<off_t>>>>();
+    size_t bytes = 0;
+    while (!pending_.empty() && batch->size() < opts_.max_records
+            && (batch->empty() || bytes < opts_.max_bytes)) {
+        auto &e = pending_.front();
+        size_t len = e.buf->computeChainDataLength();
+        batch->emplace_back(end_ + bytes, std::move(e.promise));
+        bytes += len;
+        pending_bytes_ -= len;
+        if (chain)
+            chain->prependChain(std::move(e.buf));
+        else
+            chain = std::move(e.buf);
+        pending_.pop_front();
+    }
+    off_t offset = end_;
+    end_ += bytes;
+    committing_ = batch->size();
+    commits_++;
+    if (!pending_.empty() && opts_.max_latency > 0) {
+        timer_.set(opts_.max_latency);
+        timer_.start();
+    }
+
+    auto self = shared_from_this();
+    auto file = file_;
+    ev_->spawn((writeAll(file, offset, std::move(chain))
+        >> [file] (Unit) {
+            return file->fsync(true);
+        })
+        .then([self, batch, offset, bytes] (Try<Unit> r) {
+            self->committing_ = 0;
+            if (r.hasException()) {
+                if (!self->error_)
+                    self->error_ = r.exception();
+                for (auto &e : *batch)
+                    e.second.setException(self->error_);
+                // later records can't land behind the gap
+                while (!self->pending_.empty()) {
+                    self->pending_.front().promise.setException(self->error_);
+                    self->pending_.pop_front();
+                }
+                self->pending_bytes_ = 0;
+                self->timer_.stop();
+            } else {
+                self->durable_ = offset + bytes;
+                for (auto &e : *batch)
+                    e.second.setValue(e.first);
+                self->maybeCommit();
+            }
+            return makeOk();
+        }));
+}
+
+}
+}
@@ -1,5 +1,7 @@
 #include <futures/io/AsyncFile.h>
 #include <futures/CpuPoolExecutor.h>
+#include <sys/uio.h>
+#include <climits>
 
 #ifdef __linux__
 #include <sys/prctl.h>
@@ -53,6 +55,47 @@ static void throwSystemError(const std::string &s) {
   throw std::system_error(errno, std::system_category(), s);
 }
 
+// iovecs over the data of a chain past its first `skip' bytes, at most
+// IOV_MAX, longer chains take several calls
+static std::vector<iovec> dataIov(const folly::IOBuf &head, size_t skip) {
+    std::vector<iovec> iov;
+    auto b = &head;
+    do {
+        if (skip >= b->length()) {
+            skip -= b->length();
+        } else {
+            iov.push_back({const_cast<uint8_t*>(b->data()) + skip,
+                    b->length() - skip});
+            skip = 0;
+        }
+        b = b->next();
+    } while (b != &head && iov.size() < IOV_MAX);
+    return iov;
+}
+
+// iovecs over the tailroom of a chain, at most IOV_MAX
+static std::vector<iovec> tailroomIov(folly::IOBuf *head) {
+    std::vector<iovec> iov;
+    auto b = head;
+    do {
+        if (b->tailroom() > 0)
+            iov.push_back({b->writableTail(), b->tailroom()});
+        b = b->next();
+    } while (b != head && iov.size() < IOV_MAX);
+    return iov;
+}
+
+// turn `n' bytes read into the tailroom of a chain into data
+static void appendRead(folly::IOBuf *head, size_t n) {
+    auto b = head;
+    do {
+        size_t len = std::min<size_t>(n, b->tailroom());
+        b->append(len);
+        n -= len;
+        b = b->next();
+    } while (n > 0 && b != head);
+}
+
 void AsyncFile::openSync(const std::string &path, int flags, mode_t mode)
 {
     file_ = folly::File(path.c_str(), flags, mode);
@@ -60,6 +103,13 @@ void AsyncFile::openSync(const std::string &path, int flags, mode_t mode)
 
 BoxedFuture<Unit> AsyncFile::open(const std::string &path, int flags, mode_t mode) {
     auto self = shared_from_this();
+    if (ring_) {
+        return (FileRingFuture(ring_->openat(path, flags, mode))
+            | [self] (FileRing::TokenPtr tok) {
+                self->file_ = folly::File(tok->res, true);
+                return unit;
+            }).boxed();
+    }
     return FileIOPool::getExecutor().spawn_fn([self, path, flags, mode] () {
         self->openSync(path, flags, mode);
         return unit;
@@ -78,6 +128,72 @@ again:
     return size;
 }
 
+ssize_t AsyncFile::preadSync(void *buf, size_t count, off_t offset)
+{
+again:
+    ssize_t size = ::pread(file_.fd(), buf, count, offset);
+    if (size < 0) {
+        if (errno == EINTR) goto again;
+        throwSystemError("pread");
+    }
+    return size;
+}
+
+ssize_t AsyncFile::preadvSync(const iovec *iov, int iovcnt, off_t offset)
+{
+again:
+    ssize_t size = ::preadv(file_.fd(), iov, iovcnt, offset);
+    if (size < 0) {
+        if (errno == EINTR) goto again;
+        throwSystemError("preadv");
+    }
+    return size;
+}
+
+BoxedFuture<AsyncFile::buf_ptr> AsyncFile::pread(off_t offset, size_t count)
+{
+    return preadv(offset, folly::IOBuf::create(count));
+}
+
+BoxedFuture<AsyncFile::buf_ptr> AsyncFile::preadv(off_t offset, buf_ptr bufs)
+{
+    // until the tailroom is full or end of file
+    if (ring_)
+        return ringReadv(offset, std::move(bufs));
+    auto self = shared_from_this();
+    auto m = folly::makeMoveWrapper(bufs);
+    return FileIOPool::getExecutor().spawn_fn([self, m, offset] () {
+        auto bufs = m.move();
+        off_t pos = offset;
+        while (true) {
+            auto iov = tailroomIov(bufs.get());
+            if (iov.empty())
+                break;
+            ssize_t size = self->preadvSync(iov.data(), iov.size(), pos);
+            if (size == 0)
+                break;
+            appendRead(bufs.get(), size);
+            pos += size;
+        }
+        return bufs;
+    });
+}
+
+BoxedFuture<AsyncFile::buf_ptr> AsyncFile::ringReadv(off_t offset, buf_ptr bufs)
+{
+    // submitted now, only the rest of a short read waits for the loop
+    auto self = shared_from_this();
+    auto iov = tailroomIov(bufs.get());
+    return (FileRingFuture(ring_->readv(fd(), std::move(bufs), std::move(iov), offset))
+        >> [self, offset] (FileRing::TokenPtr tok) {
+            size_t n = tok->res;
+            appendRead(tok->buf.get(), n);
+            if (n == 0 || tailroomIov(tok->buf.get()).empty())
+                return makeOk(std::move(tok->buf)).boxed();
+            return self->ringReadv(offset + n, std::move(tok->buf));
+        }).boxed();
+}
+
 BoxedFuture<AsyncFile::buf_ptr> AsyncFile::read(size_t count)
 {
   auto buf = folly::IOBuf::create(count);
@@ -87,6 +203,13 @@ BoxedFuture<AsyncFile::buf_ptr> AsyncFile::read(size_t count)
 BoxedFuture<AsyncFile::buf_ptr> AsyncFile::read(buf_ptr buf)
 {
     auto self = shared_from_this();
+    if (ring_) {
+        return (FileRingFuture(ring_->read(fd(), std::move(buf)))
+            | [self] (FileRing::TokenPtr tok) {
+                tok->buf->append(tok->res);
+                return std::move(tok->buf);
+            }).boxed();
+    }
     auto m = folly::makeMoveWrapper(buf);
     return FileIOPool::getExecutor().spawn_fn([self, m] () {
         auto buf = m.move();
@@ -108,16 +231,72 @@ again:
     return size;
 }
 
+ssize_t AsyncFile::writevSync(const iovec *iov, int iovcnt)
+{
+again:
+    ssize_t size = ::writev(file_.fd(), iov, iovcnt);
+    if (size < 0) {
+        if (errno == EINTR) goto again;
+        throwSystemError("writev");
+    }
+    return size;
+}
+
+ssize_t AsyncFile::pwritevSync(const iovec *iov, int iovcnt, off_t offset)
+{
+again:
+    ssize_t size = ::pwritev(file_.fd(), iov, iovcnt, offset);
+    if (size < 0) {
+        if (errno == EINTR) goto again;
+        throwSystemError("pwritev");
+    }
+    return size;
+}
+
 BoxedFuture<ssize_t> AsyncFile::write(buf_ptr buf)
+{
+    return pwrite(-1, std::move(buf));
+}
+
+BoxedFuture<ssize_t> AsyncFile::pwrite(off_t offset, buf_ptr buf)
 {
     auto self = shared_from_this();
+    size_t total = buf->computeChainDataLength();
+    if (ring_)
+        return ringWritev(offset, std::move(buf), 0, total);
     auto m = folly::makeMoveWrapper(buf);
-    return FileIOPool::getExecutor().spawn_fn([self, m] () {
+    return FileIOPool::getExecutor().spawn_fn([self, m, offset, total] () {
         auto buf = m.move();
-        return self->writeSync(buf->data(), buf->length());
+        size_t done = 0;
+        do {
+            auto iov = dataIov(*buf, done);
+            ssize_t size = offset == -1
+                ? self->writevSync(iov.data(), iov.size())
+                : self->pwritevSync(iov.data(), iov.size(), offset + done);
+            if (size == 0)
+                break;
+            done += size;
+        } while (done < total);
+        return static_cast<ssize_t>(done);
     });
 }
 
+BoxedFuture<ssize_t> AsyncFile::ringWritev(off_t offset, buf_ptr buf,
+        size_t done, size_t total)
+{
+    // submitted now, only the rest of a short write waits for the loop
+    auto self = shared_from_this();
+    auto iov = dataIov(*buf, done);
+    return (FileRingFuture(ring_->writev(fd(), std::move(buf), std::move(iov),
+                    offset == -1 ? -1 : offset + done))
+        >> [self, offset, done, total] (FileRing::TokenPtr tok) {
+            size_t n = done + static_cast<size_t>(tok->res);
+            if (tok->res == 0 || n >= total)
+                return makeOk(static_cast<ssize_t>(n)).boxed();
+            return self->ringWritev(offset, std::move(tok->buf), n, total);
+        }).boxed();
+}
+
 void AsyncFile::fsyncSync(bool data_only) {
     if (data_only) {
 #if __linux__
@@ -134,6 +313,12 @@ void AsyncFile::fsyncSync(bool data_only) {
 
 BoxedFuture<Unit> AsyncFile::fsync(bool data_only) {
     auto self = shared_from_this();
+    if (ring_) {
+        return (FileRingFuture(ring_->fsync(fd(), data_only))
+            | [self] (FileRing::TokenPtr tok) {
+                return unit;
+            }).boxed();
+    }
     return FileIOPool::getExecutor().spawn_fn([self, data_only] () {
         self->fsyncSync(data_only);
         return unit;
@@ -146,6 +331,12 @@ void AsyncFile::closeSync() {
 
 BoxedFuture<Unit> AsyncFile::close() {
     auto self = shared_from_this();
+    if (ring_) {
+        return (FileRingFuture(ring_->close(file_.release()))
+            | [self] (FileRing::TokenPtr tok) {
+                return unit;
+            }).boxed();
+    }
     return FileIOPool::getExecutor().spawn_fn([self] () {
         self->closeSync();
         return unit;
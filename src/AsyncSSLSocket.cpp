@@ -105,12 +105,14 @@ bool SSLSocketChannel::willBlock(int ret, int *sslErr, unsigned long *errOut)
   *errOut = 0;
   int error = *sslErr = SSL_get_error(ssl_, ret);
   if (error == SSL_ERROR_WANT_READ) {
+      rio_.clearReady();
       rio_.start();
       wio_.stop();
       return true;
   } else if (error == SSL_ERROR_WANT_WRITE) {
       FUTURES_DLOG(INFO) << "SSL_ERROR_WANT_WRITE";
       rio_.stop();
+      wio_.clearReady();
       wio_.start();
       return true;
   } else {
@@ -0,0 +1,168 @@
+#include <futures/io/AsyncServerSocket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+namespace futures {
+namespace io {
+
+// pause before accepting again when out of descriptors or memory
+static const double kAcceptBackoff = 0.1;
+
+// A socket file left behind by a previous process makes bind() fail with
+// EADDRINUSE; it is removed if nobody accepts on it anymore. Abstract
+// addresses vanish with their last descriptor.
+static bool unlinkStaleSocket(const folly::SocketAddress &addr) {
+    std::string path = addr.getPath();
+    if (path.empty() || path[0] == '\0')
+        return false;
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode))
+        return false;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+    sockaddr_storage sa;
+    socklen_t salen = addr.getAddress(&sa);
+    bool stale = ::connect(fd, reinterpret_cast<sockaddr*>(&sa), salen) < 0
+        && errno == ECONNREFUSED;
+    ::close(fd);
+    return stale && ::unlink(path.c_str()) == 0;
+}
+
+AsyncServerSocket::AsyncServerSocket(EventExecutor *ev,
+        const folly::SocketAddress &bind, const ServerSocketOptions &opts)
+    : IOObject(ev), rio_(ev), backoff_(ev->getLoop()), opts_(opts) {
+    std::error_code ec;
+    const int family = bind.getFamily();
+    socket_.open(family, ec);
+    if (ec) throw IOError("socket", ec);
+    if (family != AF_UNIX)
+        socket_.setOption(SOL_SOCKET, SO_REUSEADDR, 1, ec);
+#ifdef SO_REUSEPORT
+    if (!ec && opts.reuse_port)
+        socket_.setOption(SOL_SOCKET, SO_REUSEPORT, 1, ec);
+#endif
+    if (!ec && family == AF_INET6)
+        socket_.setOption(IPPROTO_IPV6, IPV6_V6ONLY, opts.v6_only, ec);
+    if (ec) throw IOError("setsockopt", ec);
+
+    socket_.bind(bind, ec);
+    if (ec == std::errc::address_in_use && family == AF_UNIX
+            && unlinkStaleSocket(bind)) {
+        ec.clear();
+        socket_.bind(bind, ec);
+    }
+    if (ec) throw IOError("bind", ec);
+
+    if (family == AF_INET || family == AF_INET6) {
+        // both are hints, a kernel without them still serves connections
+#ifdef TCP_DEFER_ACCEPT
+        if (opts.defer_accept > 0) {
+            socket_.setOption(IPPROTO_TCP, TCP_DEFER_ACCEPT, opts.defer_accept, ec);
+            if (ec) FUTURES_LOG(WARNING) << "TCP_DEFER_ACCEPT: " << ec.message();
+            ec.clear();
+        }
+#endif
+#ifdef TCP_FASTOPEN
+        if (opts.fastopen_queue > 0) {
+            socket_.setOption(IPPROTO_TCP, TCP_FASTOPEN, opts.fastopen_queue, ec);
+            if (ec) FUTURES_LOG(WARNING) << "TCP_FASTOPEN: " << ec.message();
+            ec.clear();
+        }
+#endif
+    }
+
+    socket_.listen(opts.backlog, ec);
+    if (ec) throw IOError("listen", ec);
+
+    rio_.set<AsyncServerSocket, &AsyncServerSocket::onEvent>(this);
+    rio_.set(socket_.fd(), ev::READ);
+    backoff_.set<AsyncServerSocket, &AsyncServerSocket::onBackoff>(this);
+}
+
+AsyncServerSocket::AsyncServerSocket(EventExecutor *ev, tcp::Socket listener,
+        const ServerSocketOptions &opts)
+    : IOObject(ev), socket_(std::move(listener)),
+      rio_(ev), backoff_(ev->getLoop()), opts_(opts) {
+    int listening = 0;
+    socklen_t len = sizeof(listening);
+    if (::getsockopt(socket_.fd(), SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) < 0)
+        throw IOError("getsockopt", std::error_code(errno, std::system_category()));
+    if (!listening)
+        throw IOError("listen", std::make_error_code(std::errc::invalid_argument));
+    int flags = ::fcntl(socket_.fd(), F_GETFL);
+    if (flags < 0 || ::fcntl(socket_.fd(), F_SETFL, flags | O_NONBLOCK) < 0)
+        throw IOError("fcntl", std::error_code(errno, std::system_category()));
+    ::fcntl(socket_.fd(), F_SETFD, FD_CLOEXEC);
+
+    rio_.set<AsyncServerSocket, &AsyncServerSocket::onEvent>(this);
+    rio_.set(socket_.fd(), ev::READ);
+    backoff_.set<AsyncServerSocket, &AsyncServerSocket::onBackoff>(this);
+}
+
+void AsyncServerSocket::onEvent(ev::io& watcher, int revent) {
+    if (!(revent & ev::READ))
+        return;
+    auto &list = getPending(IOObject::OpRead);
+    if (list.empty()) {
+        rio_.stop();
+        return;
+    }
+    folly::SocketAddress addr;
+    std::error_code ec;
+    auto p = static_cast<AcceptCompletionToken*>(&list.front());
+    // bounded, so a connection burst neither starves the other watchers on
+    // this loop nor piles up sockets nobody is consuming yet
+    for (size_t n = 0; n < opts_.max_accepts; ++n) {
+        if (p->queued() >= opts_.max_accepts) {
+            rio_.stop();
+            break;
+        }
+        tcp::Socket s = socket_.accept(ec, &addr);
+        if (ec) {
+            switch (ec.value()) {
+            case ECONNABORTED:
+            case EPROTO:
+            case EPERM:
+                // that connection is gone, not the listener
+                ec.clear();
+                continue;
+            case EMFILE:
+            case ENFILE:
+            case ENOBUFS:
+            case ENOMEM:
+                FUTURES_LOG(WARNING) << "accept: " << ec.message();
+                rio_.stop();
+                backoff_.start(kAcceptBackoff);
+                return;
+            default:
+                p->ec = ec;
+                p->notifyDone();
+                forceClose();
+                return;
+            }
+        } else if (!s.isValid()) {
+            // would block
+            rio_.clearReady();
+            break;
+        } else {
+            s.applyOptions(opts_.accepted, ec);
+            if (ec) {
+                FUTURES_LOG(WARNING) << "accepted socket options: " << ec.message();
+                ec.clear();
+            }
+            p->append(std::make_tuple(std::move(s), addr));
+            p->notify();
+        }
+    }
+}
+
+void AsyncServerSocket::onBackoff(ev::timer& watcher, int revent) {
+    resumeAccept();
+}
+
+}
+}
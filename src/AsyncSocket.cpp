@@ -1,10 +1,40 @@
 #include <futures/io/AsyncSocket.h>
+#include <futures/io/SigPipeGuard.h>
+#include <futures/detail/LoopFn.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <climits>
+#include <cstring>
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#define FUTURES_HAVE_ZEROCOPY 1
+#endif
 
 namespace futures {
 namespace io {
 
+// upper bound of iovecs gathered from all queued writers per writev
+static const size_t kMaxGatherIov = IOV_MAX;
+// buffers of one scatter read, the last one is the executor's
+static const size_t kMaxReadIov = 16;
+
+// largest count sendfile(2) accepts in one call
+static const size_t kMaxSendFile = 0x7ffff000;
+// buffer size when a file cannot be sent with sendfile(2)
+static const size_t kSendFileChunk = 64 * 1024;
+
+// data or EOF is waiting on the socket
+static bool hasUnreadInput(int fd) {
+    char c;
+    return ::recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) >= 0;
+}
+
+constexpr double SocketChannel::kZeroCopyPollInterval;
+
 bool SocketChannel::startConnect(std::error_code &ec) {
-    bool r = socket_.connect(peer_addr_, ec);
+    bool r = socket_.connect(peer_addr_, options_, ec);
     if (!ec) {
         s_ = CONNECTING;
     } else {
@@ -46,7 +76,20 @@ ssize_t SocketChannel::performWrite(
 }
 
 ssize_t SocketChannel::performRead(void* buf, size_t buflen, std::error_code &ec) {
-    ssize_t r = socket_.recv(buf, buflen, 0, ec);
+    ssize_t r = recv_fds_
+        ? socket_.recvWithFds(buf, buflen, &received_fds_, ec)
+        : socket_.recv(buf, buflen, 0, ec);
+    if (!ec) {
+        return r == 0 ? READ_EOF : r;
+    } else if (ec == std::make_error_code(std::errc::operation_would_block)) {
+        return READ_WOULDBLOCK;
+    } else {
+        return READ_ERROR;
+    }
+}
+
+ssize_t SocketChannel::performReadv(const iovec *vec, size_t count, std::error_code &ec) {
+    ssize_t r = socket_.readv(vec, count, ec);
     if (!ec) {
         return r == 0 ? READ_EOF : r;
     } else if (ec == std::make_error_code(std::errc::operation_would_block)) {
@@ -57,40 +100,440 @@ ssize_t SocketChannel::performRead(void* buf, size_t buflen, std::error_code &ec
 }
 
 ssize_t SocketChannel::handleRead(ReaderCompletionToken *tok, std::error_code &ec) {
-    const static size_t kMaxReadPerEvent = 12;
+    // read into the executor's buffer, so idle connections pin no memory
+    auto rbuf = getExecutor()->getReadBuffer(read_policy_.max_read);
+    iovec vec[kMaxReadIov];
+    bool scatter = canScatterRead();
     size_t reads = 0;
-    while (reads < kMaxReadPerEvent) {
-        void *buf;
-        size_t bufLen = 0;
-        tok->prepareBuffer(&buf, &bufLen);
-        assert(buf);
-        assert(bufLen > 0);
-        ssize_t read_ret = performRead(buf, bufLen, ec);
+    size_t bytes = 0;
+    while (reads < read_policy_.max_reads_per_event
+            && bytes < read_policy_.max_bytes_per_event) {
+        // tokens that take scatter reads get the burst in their own
+        // buffers, sized to recent reads, whatever does not fit lands in
+        // the executor's buffer
+        size_t nvec = scatter
+            ? tok->prepareBuffers(vec, kMaxReadIov - 1, read_sizer_.next()) : 0;
+        size_t offered = 0;
+        size_t room = rbuf.second;
+        ssize_t read_ret;
+        if (nvec) {
+            for (size_t i = 0; i < nvec; ++i)
+                offered += vec[i].iov_len;
+            vec[nvec].iov_base = rbuf.first;
+            vec[nvec].iov_len = rbuf.second;
+            room = offered + rbuf.second;
+            read_ret = performReadv(vec, nvec + 1, ec);
+        } else {
+            read_ret = performRead(rbuf.first, rbuf.second, ec);
+        }
         FUTURES_DLOG(INFO) << "readed: " << read_ret;
         if (read_ret == READ_ERROR) {
             tok->readError(ec);
             return read_ret;
         } else if (read_ret == READ_WOULDBLOCK) {
-            // XXX not needed?
-            tok->dataReady(0);
+            // release the segments offered for nothing
+            if (nvec)
+                tok->buffersFilled(0);
+            rio_.clearReady();
             return read_ret;
         } else if (read_ret == READ_EOF) {
             FUTURES_DLOG(INFO) << "Socket EOF";
             tok->readEof();
             return read_ret;
         } else {
-            tok->dataReady(read_ret);
+            touchRead();
+            if (nvec) {
+                read_sizer_.record(offered, read_ret);
+                tok->buffersFilled(std::min<size_t>(read_ret, offered));
+                if ((size_t)read_ret > offered)
+                    tok->dataReceived(rbuf.first, read_ret - offered);
+            } else {
+                tok->dataReceived(rbuf.first, read_ret);
+            }
             reads++;
-            if (read_ret < bufLen) {
+            bytes += read_ret;
+            if ((size_t)read_ret < room) {
+                rio_.clearReady();
                 return read_ret;
             }
         }
     }
+    // budget used up, the watcher fires again next loop
     return READ_WOULDBLOCK;
 }
 
+void SocketChannel::handleWrite() {
+    auto &writer = getPending(IOObject::OpWrite);
+    while (!writer.empty()) {
+        // gather iovecs of all queued writers into a single writev, a
+        // large write in zero-copy mode is sent on its own
+        size_t gathered = 0;
+        bool zerocopy = false;
+        WriterCompletionToken *passing = nullptr;
+        WriterCompletionToken *file = nullptr;
+        wvec_.clear();
+        auto it = writer.begin();
+        while (it != writer.end() && wvec_.size() < kMaxGatherIov) {
+            auto p = static_cast<WriterCompletionToken*>(&*it);
+            ++it;
+            if (p->isZeroCopyPending())
+                continue;
+            if (p->isFileRange()) {
+                // sent on its own once the writes before it are out
+                if (wvec_.empty())
+                    file = p;
+                break;
+            }
+            iovec *vec;
+            size_t vecLen = 0;
+            p->prepareIov(&vec, &vecLen);
+            if (!vecLen) {
+                p->notifyDone();
+                continue;
+            }
+            size_t bytes = 0;
+            for (size_t i = 0; i < vecLen; ++i)
+                bytes += vec[i].iov_len;
+            if (!p->getPassedFds().empty()) {
+                // descriptors go with the first byte of their own write
+                if (!wvec_.empty())
+                    break;
+                passing = p;
+            } else if (zc_threshold_ && bytes >= zc_threshold_) {
+                if (!wvec_.empty())
+                    break;
+                zerocopy = true;
+            }
+            vecLen = std::min(vecLen, kMaxGatherIov - wvec_.size());
+            for (size_t i = 0; i < vecLen; ++i)
+                gathered += vec[i].iov_len;
+            wvec_.insert(wvec_.end(), vec, vec + vecLen);
+            if (zerocopy || passing)
+                break;
+        }
+        if (file) {
+            std::error_code ec;
+            if (sendFileRange(file, ec))
+                continue;
+            if (ec) {
+                file->writeError(ec);
+                cleanup(CancelReason::IOObjectShutdown);
+                return;
+            }
+            wio_.clearReady();
+            break;
+        }
+        if (wvec_.empty())
+            break;
+
+        std::error_code ec;
+        size_t countWritten;
+        size_t partialWritten;
+        ssize_t totalWritten = 0;
+        if (passing) {
+            totalWritten = socket_.sendWithFds(wvec_.data(), wvec_.size(),
+                    passing->getPassedFds(), ec);
+            if (!ec && totalWritten > 0) {
+                copied_bytes_ += totalWritten;
+                passing->clearPassedFds();
+            }
+        }
+#ifdef FUTURES_HAVE_ZEROCOPY
+        else if (zerocopy) {
+            totalWritten = socket_.writev(wvec_.data(), wvec_.size(),
+                    MSG_ZEROCOPY, ec);
+            if (!ec && totalWritten > 0)
+                zc_sends_.emplace_back(zc_next_id_++, totalWritten);
+            if (ec == std::errc::no_buffer_space) {
+                // out of optmem for page pinning, fall back to copy
+                ec = std::error_code();
+                zerocopy = false;
+            }
+        }
+        if (!zerocopy && !passing)
+#else
+        else
+#endif
+        {
+            totalWritten = performWrite(wvec_.data(), wvec_.size(),
+                    &countWritten, &partialWritten, ec);
+            if (!ec)
+                copied_bytes_ += totalWritten;
+        }
+        if (ec) {
+            static_cast<WriterCompletionToken*>(&writer.front())->writeError(ec);
+            cleanup(CancelReason::IOObjectShutdown);
+            return;
+        }
+        if (totalWritten > 0)
+            touchWrite();
+
+        // complete writers in queue order according to bytes written
+        size_t remain = totalWritten;
+        it = writer.begin();
+        while (it != writer.end()) {
+            auto p = static_cast<WriterCompletionToken*>(&*it);
+            ++it;
+            if (p->isZeroCopyPending())
+                continue;
+            if (p->isFileRange())
+                break;
+            iovec *vec;
+            size_t vecLen = 0;
+            p->prepareIov(&vec, &vecLen);
+            size_t n = 0;
+            size_t bytes = 0;
+            while (n < vecLen && vec[n].iov_len <= remain) {
+                remain -= vec[n].iov_len;
+                bytes += vec[n].iov_len;
+                n++;
+            }
+            if (n == vecLen) {
+                p->updateIov(bytes, n, 0);
+                if (zerocopy)
+                    p->setZeroCopyPending(zc_next_id_ - 1);
+                else
+                    p->notifyDone();
+            } else {
+                p->updateIov(bytes + remain, n, remain);
+                break;
+            }
+        }
+        if ((size_t)totalWritten < gathered) {
+            wio_.clearReady();
+            break;
+        }
+    }
+
+    bool unsent = false;
+    for (auto &e : writer) {
+        if (!static_cast<WriterCompletionToken&>(e).isZeroCopyPending()) {
+            unsent = true;
+            break;
+        }
+    }
+    if (writer.empty()) {
+        wio_.stop();
+        if (shutdown_flags_ & SHUT_WRITE_PENDING)
+            shutdownWriteNow();
+    } else if (!unsent) {
+        // completions are delivered on the error queue, which wakes up
+        // the read watcher
+        wio_.stop();
+        rio_.start();
+    } else if (s_ == CONNECTED) {
+        wio_.start();
+    }
+}
+
+// false if the socket buffer filled up or on error
+bool SocketChannel::sendFileRange(WriterCompletionToken *p, std::error_code &ec) {
+    // sendfile(2) has no MSG_NOSIGNAL, a peer reset must not raise SIGPIPE
+    SigPipeGuard guard;
+    while (p->getFileRemaining() > 0) {
+        off_t offset = p->getFileOffset();
+        ssize_t n = ::sendfile(socket_.fd(), p->getFileFd(), &offset,
+                std::min(p->getFileRemaining(), kMaxSendFile));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN)
+                ec = std::error_code(errno, std::system_category());
+            return false;
+        }
+        if (n == 0)
+            break;
+        p->fileSent(n);
+        touchWrite();
+    }
+    p->notifyDone();
+    return true;
+}
+
+void SocketChannel::setReadTimeout(double secs) {
+    read_timeout_ = secs;
+    read_deadline_ = 0;
+    if (secs > 0 && !getPending(IOObject::OpRead).empty())
+        read_deadline_ = getExecutor()->getNow() + secs;
+    rearmTimeouts();
+}
+
+void SocketChannel::setWriteTimeout(double secs) {
+    write_timeout_ = secs;
+    write_deadline_ = 0;
+    if (secs > 0 && !getPending(IOObject::OpWrite).empty())
+        write_deadline_ = getExecutor()->getNow() + secs;
+    rearmTimeouts();
+}
+
+void SocketChannel::setIdleTimeout(double secs) {
+    idle_timeout_ = secs;
+    idle_deadline_ = secs > 0 ? getExecutor()->getNow() + secs : 0;
+    rearmTimeouts();
+}
+
+void SocketChannel::rearmTimeouts() {
+    double next = 0;
+    for (double d : {read_deadline_, write_deadline_, idle_deadline_})
+        if (d > 0 && (next == 0 || d < next))
+            next = d;
+    auto &q = getExecutor()->getDeadlines();
+    if (next == 0 || s_ == CLOSED)
+        q.cancel(&timeout_entry_);
+    else
+        q.schedule(&timeout_entry_, next);
+}
+
+void SocketChannel::onTimeout() {
+    if (s_ == CLOSED)
+        return;
+    double now = getExecutor()->getNow();
+    auto ec = std::make_error_code(std::errc::timed_out);
+    auto &reader = getPending(IOObject::OpRead);
+    auto &writer = getPending(IOObject::OpWrite);
+    if (read_deadline_ > 0 && now >= read_deadline_) {
+        read_deadline_ = 0;
+        if (!reader.empty())
+            static_cast<ReaderCompletionToken*>(&reader.front())->readError(ec);
+    }
+    bool close = idle_deadline_ > 0 && now >= idle_deadline_;
+    if (write_deadline_ > 0 && now >= write_deadline_) {
+        write_deadline_ = 0;
+        // the peer got an unknown part of the stream, don't continue it
+        if (!writer.empty())
+            close = true;
+    }
+    if (close) {
+        FUTURES_DLOG(INFO) << "timed out, fd: " << socket_.fd();
+        idle_deadline_ = 0;
+        while (!reader.empty())
+            static_cast<ReaderCompletionToken*>(&reader.front())->readError(ec);
+        while (!writer.empty())
+            static_cast<WriterCompletionToken*>(&writer.front())->writeError(ec);
+        cleanup(CancelReason::IOObjectShutdown);
+        return;
+    }
+    rearmTimeouts();
+}
+
+bool SocketChannel::setZeroCopy(bool enable, size_t threshold) {
+#ifdef FUTURES_HAVE_ZEROCOPY
+    if (!enable) {
+        zc_threshold_ = 0;
+        return true;
+    }
+    if (!socket_.isValid())
+        return false;
+    int val = 1;
+    if (::setsockopt(socket_.fd(), SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)))
+        return false;
+    zc_threshold_ = std::max<size_t>(threshold, 1);
+    return true;
+#else
+    return !enable;
+#endif
+}
+
+void SocketChannel::handleZeroCopyCompletion() {
+#ifdef FUTURES_HAVE_ZEROCOPY
+    auto &writer = getPending(IOObject::OpWrite);
+    bool completed = false;
+    while (!zc_sends_.empty()) {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t r = ::recvmsg(socket_.fd(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm;
+                cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                    || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+                continue;
+            auto serr = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+            // sends [ee_info, ee_data] are released, in order for TCP
+            uint32_t hi = serr->ee_data;
+            bool copied = serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED;
+            while (!zc_sends_.empty()
+                    && (int32_t)(hi - zc_sends_.front().first) >= 0) {
+                if (copied)
+                    copied_bytes_ += zc_sends_.front().second;
+                else
+                    zerocopy_bytes_ += zc_sends_.front().second;
+                zc_sends_.pop_front();
+            }
+            while (!zc_held_.empty()
+                    && (int32_t)(hi - zc_held_.front().first) >= 0)
+                zc_held_.pop_front();
+            auto it = writer.begin();
+            while (it != writer.end()) {
+                auto p = static_cast<WriterCompletionToken*>(&*it);
+                ++it;
+                if (p->isZeroCopyPending()
+                        && (int32_t)(hi - p->getZeroCopyId()) >= 0) {
+                    p->notifyDone();
+                    completed = true;
+                }
+            }
+        }
+    }
+    if (completed)
+        handleWrite();
+#endif
+}
+
+void SocketChannel::schedulePollZeroCopy() {
+    if (zc_poll_entry_.isArmed())
+        return;
+    auto &q = getExecutor()->getDeadlines();
+    q.schedule(&zc_poll_entry_, q.now() + kZeroCopyPollInterval);
+}
+
+void SocketChannel::pollZeroCopy() {
+    handleZeroCopyCompletion();
+    if (zc_sends_.empty()) {
+        if (s_ == CLOSED)
+            socket_.close();
+        return;
+    }
+    if (s_ == CLOSED || !rio_.is_active())
+        schedulePollZeroCopy();
+}
+
+void SocketChannel::cleanup(CancelReason reason) {
+    // cancelled writes drop their buffers, the ones of zero-copy sends are
+    // kept until the kernel released them
+    for (auto &e : getPending(IOObject::OpWrite)) {
+        auto &p = static_cast<WriterCompletionToken&>(e);
+        if (p.isZeroCopyPending())
+            zc_held_.emplace_back(p.getZeroCopyId(), p.releaseBuffer());
+    }
+    Channel::cleanup(reason);
+}
+
+void SocketChannel::pauseReading() {
+    read_paused_ = true;
+    // zero-copy completions still arrive on the error queue
+    if (zc_sends_.empty())
+        rio_.stop();
+}
+
+void SocketChannel::resumeReading() {
+    read_paused_ = false;
+    if (s_ == CONNECTED && !(shutdown_flags_ & SHUT_READ)
+            && !getPending(IOObject::OpRead).empty())
+        rio_.start();
+}
+
 void SocketChannel::handleInitialReadWrite() {
-    if (getPending(IOObject::OpRead).empty())
+    if (getPending(IOObject::OpRead).empty() || read_paused_)
         rio_.stop();
     else
         rio_.start();
@@ -104,10 +547,12 @@ void SocketChannel::handleInitialReadWrite() {
 void SocketChannel::onEvent(ev::io& watcher, int revent) {
     if (revent & ev::ERROR)
         throw std::runtime_error("syscall error");
+    if (!zc_sends_.empty() && s_ == CONNECTED)
+        handleZeroCopyCompletion();
     if (revent & ev::READ) {
         if (s_ == CONNECTED) {
             auto &reader = getPending(IOObject::OpRead);
-            if (!reader.empty()) {
+            if (!reader.empty() && !read_paused_) {
                 auto first = static_cast<ReaderCompletionToken*>(&reader.front());
                 std::error_code ec;
                 ssize_t ret = handleRead(first, ec);
@@ -119,8 +564,16 @@ void SocketChannel::onEvent(ev::io& watcher, int revent) {
                 } else if (ret == READ_WOULDBLOCK) {
                     // nothing
                 }
-            } else {
+            } else if (zc_sends_.empty()) {
+                rio_.stop();
+            } else if (hasUnreadInput(socket_.fd())) {
+                // data or EOF without a reader keeps a level-triggered
+                // watcher firing, poll the error queue instead
                 rio_.stop();
+                schedulePollZeroCopy();
+            } else {
+                // only the error queue was ready and it is drained
+                rio_.clearReady();
             }
         }
     }
@@ -143,47 +596,9 @@ void SocketChannel::onEvent(ev::io& watcher, int revent) {
                 return;
             }
         }
-        if (s_ == CONNECTED) {
-            auto &writer = getPending(IOObject::OpWrite);
-            while (!writer.empty()) {
-                auto p = static_cast<WriterCompletionToken*>(&writer.front());
-                std::error_code ec;
-                iovec *vec;
-                size_t vecLen = 0;
-                p->prepareIov(&vec, &vecLen);
-                if (!vecLen) {
-                    p->notifyDone();
-                    continue;
-                }
-                size_t countWritten;
-                size_t partialWritten;
-                ssize_t totalWritten = performWrite(vec, vecLen,
-                        &countWritten, &partialWritten, ec);
-                if (!ec) {
-                    p->updateIov(totalWritten, countWritten, partialWritten);
-                    if (countWritten == vecLen) {
-                        p->notifyDone();
-                        if (shutdown_flags_ & SHUT_WRITE_PENDING) {
-                            shutdownWriteNow();
-                            break;
-                        }
-                    } else {
-                        break;
-                    }
-                } else {
-                    p->writeError(ec);
-                    cleanup(CancelReason::IOObjectShutdown);
-                    break;
-                }
-            }
-            if (writer.empty()) {
-                wio_.stop();
-                if (shutdown_flags_ & SHUT_WRITE_PENDING)
-                    shutdownWriteNow();
-            }
-        }
+        if (s_ == CONNECTED)
+            handleWrite();
     }
-
 }
 
 // future API
@@ -192,11 +607,46 @@ SocketChannel::connect(EventExecutor *ev, const folly::SocketAddress &addr) {
     return SockConnectFuture(ev, addr);
 }
 
+SockConnectFuture
+SocketChannel::connect(EventExecutor *ev, const folly::SocketAddress &addr,
+        const tcp::SocketOptions &opts) {
+    return SockConnectFuture(ev, addr, opts);
+}
+
 WriteFuture
 SocketChannel::write(std::unique_ptr<folly::IOBuf> buf) {
     return WriteFuture(shared_from_this(), std::move(buf));
 }
 
+WriteFuture
+SocketChannel::writeWithFds(std::unique_ptr<folly::IOBuf> buf, std::vector<int> fds) {
+    return WriteFuture(shared_from_this(), std::move(buf), std::move(fds));
+}
+
+BoxedFuture<ssize_t>
+SocketChannel::sendFile(AsyncFile::Ptr file, off_t offset, size_t length) {
+    struct stat st;
+    if (canSendFile() && ::fstat(file->fd(), &st) == 0 && S_ISREG(st.st_mode))
+        return SendFileFuture(shared_from_this(), file, offset, length).boxed();
+
+    auto self = shared_from_this();
+    return makeLoop(size_t(0), [self, file, offset, length] (size_t sent) {
+        return file->pread(offset + sent,
+                std::min(kSendFileChunk, length - sent))
+            >> [self, sent, length] (std::unique_ptr<folly::IOBuf> buf) {
+                size_t total = sent + buf->length();
+                bool last = buf->empty() || total >= length;
+                auto next = [total, last] (ssize_t) {
+                    return last ? makeBreak<ssize_t, size_t>(total)
+                        : makeContinue<ssize_t, size_t>(total);
+                };
+                if (buf->empty())
+                    return makeOk(next(0)).boxed();
+                return (self->write(std::move(buf)) | std::move(next)).boxed();
+            };
+    }).boxed();
+}
+
 ReadStream
 SocketChannel::readStream() {
     return ReadStream(shared_from_this());
@@ -0,0 +1,330 @@
+#include <futures/io/AsyncUdpSocket.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstring>
+
+#ifndef SOL_UDP
+#define SOL_UDP IPPROTO_UDP
+#endif
+
+namespace futures {
+namespace io {
+
+// recvmmsg batches per readiness event, see ReadPolicy for the rationale
+static const size_t kMaxBatchesPerEvent = 16;
+// receive slot with GRO on, a coalesced datagram may take up to 64K
+static const size_t kGroSlotSize = 65535;
+// kernel limits of one UDP_SEGMENT send
+static const size_t kMaxGsoSegments = 64;
+static const size_t kMaxGsoBytes = 65507;
+
+static inline std::error_code current_system_error(int e = errno) {
+    return std::error_code(e, std::system_category());
+}
+
+AsyncUdpSocket::AsyncUdpSocket(EventExecutor *ev, const folly::SocketAddress &bind)
+    : IOObject(ev), rio_(ev->getLoop()), wio_(ev->getLoop()) {
+    fd_ = ::socket(bind.getFamily(), SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0)
+        throw IOError("socket", current_system_error());
+    sockaddr_storage ss;
+    socklen_t len = bind.getAddress(&ss);
+    if (::bind(fd_, reinterpret_cast<sockaddr*>(&ss), len) < 0) {
+        auto ec = current_system_error();
+        ::close(fd_);
+        fd_ = -1;
+        throw IOError("bind", ec);
+    }
+    rio_.set<AsyncUdpSocket, &AsyncUdpSocket::onEvent>(this);
+    rio_.set(fd_, ev::READ);
+    wio_.set<AsyncUdpSocket, &AsyncUdpSocket::onEvent>(this);
+    wio_.set(fd_, ev::WRITE);
+}
+
+AsyncUdpSocket::~AsyncUdpSocket() {
+    if (fd_ >= 0) {
+        rio_.stop();
+        wio_.stop();
+        ::close(fd_);
+    }
+}
+
+folly::SocketAddress AsyncUdpSocket::getLocalAddress() const {
+    folly::SocketAddress addr;
+    addr.setFromLocalAddress(fd_);
+    return addr;
+}
+
+bool AsyncUdpSocket::setGro(bool enable) {
+#ifdef UDP_GRO
+    int val = enable ? 1 : 0;
+    if (::setsockopt(fd_, SOL_UDP, UDP_GRO, &val, sizeof(val)) < 0)
+        return false;
+    gro_ = enable;
+    return true;
+#else
+    return !enable;
+#endif
+}
+
+bool AsyncUdpSocket::setGso(uint16_t segment_size) {
+#ifdef UDP_SEGMENT
+    gso_size_ = segment_size;
+    return true;
+#else
+    return segment_size == 0;
+#endif
+}
+
+void AsyncUdpSocket::forceClose() {
+    rio_.stop();
+    wio_.stop();
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    auto &reader = getPending(IOObject::OpRead);
+    while (!reader.empty())
+        static_cast<RecvCompletionToken*>(&reader.front())->notifyDone();
+    auto &writer = getPending(IOObject::OpWrite);
+    while (!writer.empty()) {
+        static_cast<SendCompletionToken*>(&writer.front())->sendError(
+                std::make_error_code(std::errc::connection_aborted));
+    }
+}
+
+Poll<Optional<Datagram>> AsyncUdpSocket::RecvCompletionToken::pollStream() {
+    if (!q_.empty()) {
+        auto v = std::move(q_.front());
+        q_.pop_front();
+        return makePollReady(Optional<Datagram>(std::move(v)));
+    }
+    switch (getState()) {
+    case STARTED:
+        // reading pauses while the queue is full
+        static_cast<AsyncUdpSocket*>(getIOObject())->resumeRead();
+        park();
+        return Poll<Optional<Datagram>>(not_ready);
+    case DONE:
+        if (ec) {
+            return Poll<Optional<Datagram>>(IOError("recvmmsg", ec));
+        } else {
+            return Poll<Optional<Datagram>>(Optional<Datagram>());
+        }
+    case CANCELLED:
+        return Poll<Optional<Datagram>>(FutureCancelledException());
+    default:
+        throw InvalidPollStateException();
+    }
+}
+
+io::intrusive_ptr<AsyncUdpSocket::RecvCompletionToken> AsyncUdpSocket::doRecv() {
+    io::intrusive_ptr<RecvCompletionToken> tok(new RecvCompletionToken());
+    if (fd_ < 0) {
+        tok->ec = std::make_error_code(std::errc::connection_aborted);
+        tok->notifyDone();
+    } else {
+        tok->attach(this);
+        rio_.start();
+    }
+    return tok;
+}
+
+io::intrusive_ptr<AsyncUdpSocket::SendCompletionToken>
+AsyncUdpSocket::doSend(std::vector<Datagram> dgrams) {
+    io::intrusive_ptr<SendCompletionToken> tok(new SendCompletionToken(std::move(dgrams)));
+    if (fd_ < 0) {
+        tok->ec = std::make_error_code(std::errc::connection_aborted);
+        tok->notifyDone();
+        return tok;
+    }
+    tok->attach(this);
+    // datagram sockets are almost always writable, try right away
+    if (!wio_.is_active())
+        handleWrite();
+    return tok;
+}
+
+void AsyncUdpSocket::resumeRead() {
+    if (fd_ >= 0 && !rio_.is_active())
+        rio_.start();
+}
+
+void AsyncUdpSocket::onEvent(ev::io& watcher, int revent) {
+    if (revent & ev::READ)
+        handleRead();
+    if (revent & ev::WRITE)
+        handleWrite();
+}
+
+void AsyncUdpSocket::handleRead() {
+    auto &list = getPending(IOObject::OpRead);
+    if (list.empty()) {
+        rio_.stop();
+        return;
+    }
+    auto tok = static_cast<RecvCompletionToken*>(&list.front());
+
+    const size_t slot = gro_ ? std::max(max_dgram_, kGroSlotSize) : max_dgram_;
+    auto rbuf = getExecutor()->getReadBuffer(slot * kMaxBatch);
+    char *base = static_cast<char*>(rbuf.first);
+
+    mmsghdr msgs[kMaxBatch];
+    iovec iov[kMaxBatch];
+    sockaddr_storage addrs[kMaxBatch];
+    alignas(cmsghdr) char ctrl[kMaxBatch][CMSG_SPACE(sizeof(int))];
+
+    for (size_t batch = 0; batch < kMaxBatchesPerEvent; ++batch) {
+        if (tok->q_.size() >= kMaxQueued) {
+            rio_.stop();
+            break;
+        }
+        for (size_t i = 0; i < kMaxBatch; ++i) {
+            iov[i].iov_base = base + i * slot;
+            iov[i].iov_len = slot;
+            auto &hdr = msgs[i].msg_hdr;
+            hdr.msg_name = &addrs[i];
+            hdr.msg_namelen = sizeof(addrs[i]);
+            hdr.msg_iov = &iov[i];
+            hdr.msg_iovlen = 1;
+            hdr.msg_control = gro_ ? ctrl[i] : nullptr;
+            hdr.msg_controllen = gro_ ? sizeof(ctrl[i]) : 0;
+            hdr.msg_flags = 0;
+        }
+        int n = ::recvmmsg(fd_, msgs, kMaxBatch, 0, nullptr);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            tok->ec = current_system_error();
+            rio_.stop();
+            tok->notifyDone();
+            return;
+        }
+        for (int i = 0; i < n; ++i) {
+            auto &hdr = msgs[i].msg_hdr;
+            if (hdr.msg_flags & MSG_TRUNC) {
+                FUTURES_DLOG(WARNING) << "datagram larger than " << slot << " dropped";
+                continue;
+            }
+            size_t len = msgs[i].msg_len;
+            size_t seg = len;
+#ifdef UDP_GRO
+            for (cmsghdr *c = CMSG_FIRSTHDR(&hdr); c; c = CMSG_NXTHDR(&hdr, c)) {
+                if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO) {
+                    int gso = 0;
+                    memcpy(&gso, CMSG_DATA(c), sizeof(gso));
+                    if (gso > 0) seg = gso;
+                }
+            }
+#endif
+            folly::SocketAddress peer;
+            peer.setFromSockaddr(reinterpret_cast<sockaddr*>(&addrs[i]), hdr.msg_namelen);
+            const char *p = base + i * slot;
+            size_t off = 0;
+            do {
+                size_t l = std::min(seg, len - off);
+                tok->append(std::make_tuple(folly::IOBuf::copyBuffer(p + off, l), peer));
+                off += l;
+            } while (off < len);
+        }
+        tok->notify();
+        if (static_cast<size_t>(n) < kMaxBatch)
+            break;
+    }
+}
+
+void AsyncUdpSocket::handleWrite() {
+    auto &list = getPending(IOObject::OpWrite);
+    mmsghdr msgs[kMaxBatch];
+    sockaddr_storage addrs[kMaxBatch];
+    size_t counts[kMaxBatch];
+    auto &iov = send_iov_;
+    iov.resize(kMaxBatch * (gso_size_ ? kMaxGsoSegments : 1));
+#ifdef UDP_SEGMENT
+    alignas(cmsghdr) char ctrl[kMaxBatch][CMSG_SPACE(sizeof(uint16_t))];
+#endif
+
+    while (!list.empty()) {
+        auto tok = static_cast<SendCompletionToken*>(&list.front());
+        auto &d = tok->dgrams_;
+        while (tok->getState() == CompletionToken::STARTED && tok->sent_ < d.size()) {
+            size_t nmsg = 0, niov = 0;
+            size_t i = tok->sent_;
+            while (nmsg < kMaxBatch && i < d.size()) {
+                const folly::SocketAddress &addr = std::get<1>(d[i]);
+                auto &hdr = msgs[nmsg].msg_hdr;
+                memset(&hdr, 0, sizeof(hdr));
+                hdr.msg_iov = &iov[niov];
+                size_t cnt = 0;
+                size_t total = 0;
+                do {
+                    auto &buf = std::get<0>(d[i + cnt]);
+                    if (buf->isChained())
+                        buf->coalesce();
+                    iov[niov + cnt].iov_base = const_cast<uint8_t*>(buf->data());
+                    iov[niov + cnt].iov_len = buf->length();
+                    total += buf->length();
+                    cnt++;
+                    // GSO: keep appending full sized segments to the same peer,
+                    // a shorter one ends the message
+                    if (!gso_size_ || buf->length() != gso_size_)
+                        break;
+                    if (i + cnt >= d.size() || cnt >= kMaxGsoSegments)
+                        break;
+                    auto &next = d[i + cnt];
+                    if (std::get<1>(next) != addr
+                            || std::get<0>(next)->computeChainDataLength() > gso_size_
+                            || total + std::get<0>(next)->computeChainDataLength() > kMaxGsoBytes)
+                        break;
+                } while (true);
+                hdr.msg_iovlen = cnt;
+                hdr.msg_name = &addrs[nmsg];
+                hdr.msg_namelen = addr.getAddress(&addrs[nmsg]);
+#ifdef UDP_SEGMENT
+                if (cnt > 1) {
+                    hdr.msg_control = ctrl[nmsg];
+                    hdr.msg_controllen = sizeof(ctrl[nmsg]);
+                    cmsghdr *c = CMSG_FIRSTHDR(&hdr);
+                    c->cmsg_level = SOL_UDP;
+                    c->cmsg_type = UDP_SEGMENT;
+                    c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                    memcpy(CMSG_DATA(c), &gso_size_, sizeof(uint16_t));
+                }
+#endif
+                counts[nmsg++] = cnt;
+                niov += cnt;
+                i += cnt;
+            }
+
+            int n = ::sendmmsg(fd_, msgs, nmsg, MSG_DONTWAIT);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    wio_.start();
+                    return;
+                }
+                if (errno == EINTR)
+                    continue;
+                if (errno == EIO && gso_size_) {
+                    // no checksum offload on the egress device
+                    FUTURES_LOG(WARNING) << "UDP GSO unsupported, disabled";
+                    gso_size_ = 0;
+                    continue;
+                }
+                tok->sendError(current_system_error());
+                break;
+            }
+            for (int k = 0; k < n; ++k)
+                tok->sent_ += counts[k];
+        }
+        tok->notifyDone();
+    }
+    wio_.stop();
+}
+
+}
+}
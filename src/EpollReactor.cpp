@@ -0,0 +1,153 @@
+#include <futures/EpollReactor.h>
+#include <futures/io/FdWatcher.h>
+#include <futures/Exception.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace futures {
+
+static int toEvents(uint32_t e) {
+    int r = 0;
+    if (e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        r |= ev::READ;
+    if (e & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+        r |= ev::WRITE;
+    return r;
+}
+
+EpollReactor::EpollReactor(EventExecutor *ev)
+    : epfd_(::epoll_create1(EPOLL_CLOEXEC)),
+      io_(ev->getLoop()), check_(ev->getLoop()), idle_(ev->getLoop()) {
+    if (epfd_ < 0)
+        throw IOError("epoll_create1", std::error_code(errno, std::system_category()));
+    io_.set<EpollReactor, &EpollReactor::onEpoll>(this);
+    io_.set(epfd_, ev::READ);
+    io_.start();
+    check_.set<EpollReactor, &EpollReactor::onCheck>(this);
+    check_.start();
+    idle_.set<EpollReactor, &EpollReactor::onIdle>(this);
+}
+
+EpollReactor::~EpollReactor() {
+    idle_.stop();
+    check_.stop();
+    io_.stop();
+    ::close(epfd_);
+}
+
+void EpollReactor::attach(io::FdWatcher *w) {
+    const int fd = w->fd();
+    auto &r = regs_[fd];
+    if (!r) {
+        epoll_event e;
+        e.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        e.data.u64 = 0;
+        e.data.fd = fd;
+        if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &e) < 0) {
+            std::error_code ec(errno, std::system_category());
+            regs_.erase(fd);
+            throw IOError("epoll_ctl", ec);
+        }
+        r.reset(new Registration());
+        r->fd = fd;
+    }
+    r->watchers.push_back(w);
+    w->reactor_data = r.get();
+}
+
+void EpollReactor::detach(io::FdWatcher *w) {
+    auto r = static_cast<Registration*>(w->reactor_data);
+    w->reactor_data = nullptr;
+    auto &ws = r->watchers;
+    ws.erase(std::remove(ws.begin(), ws.end(), w), ws.end());
+    if (ws.empty()) {
+        // fails harmlessly if the fd is already closed
+        ::epoll_ctl(epfd_, EPOLL_CTL_DEL, r->fd, nullptr);
+        regs_.erase(r->fd);
+    }
+}
+
+void EpollReactor::update(io::FdWatcher *w) {
+    auto r = static_cast<Registration*>(w->reactor_data);
+    // readiness reported while stopped has no new edge coming
+    if (w->is_active() && (w->events() & r->ready))
+        enqueue(r);
+}
+
+void EpollReactor::clearReady(io::FdWatcher *w) {
+    auto r = static_cast<Registration*>(w->reactor_data);
+    // once the peer hung up reads never block again, and a short read may
+    // have left the EOF behind on an edge that is already consumed
+    r->ready &= ~(w->events() & ~(r->hup ? ev::READ : 0));
+}
+
+void EpollReactor::enqueue(Registration *r) {
+    if (r->queued)
+        return;
+    r->queued = true;
+    pending_.push_back(r->fd);
+    // keep the next poll from blocking
+    idle_.start();
+}
+
+void EpollReactor::dispatch(Registration *r) {
+    const int fd = r->fd;
+    // callbacks may stop, detach or destroy any watcher, including those
+    // of this registration
+    for (size_t i = 0; i < r->watchers.size(); ++i) {
+        auto w = r->watchers[i];
+        int revents = w->events() & r->ready;
+        if (w->is_active() && revents) {
+            w->invoke(revents);
+            if (!lookup(fd, r))
+                return;
+        }
+    }
+    for (auto w : r->watchers) {
+        if (w->is_active() && (w->events() & r->ready)) {
+            enqueue(r);
+            break;
+        }
+    }
+}
+
+void EpollReactor::runPending() {
+    running_.swap(pending_);
+    for (int fd : running_) {
+        auto it = regs_.find(fd);
+        if (it == regs_.end() || !it->second->queued)
+            continue;
+        it->second->queued = false;
+        dispatch(it->second.get());
+    }
+    running_.clear();
+    if (pending_.empty())
+        idle_.stop();
+}
+
+void EpollReactor::onEpoll(ev::io &w, int revents) {
+    epoll_event evs[kMaxEvents];
+    int n = ::epoll_wait(epfd_, evs, kMaxEvents, 0);
+    if (n <= 0)
+        return;
+    waits_++;
+    events_ += n;
+    for (int i = 0; i < n; ++i) {
+        auto it = regs_.find(evs[i].data.fd);
+        if (it == regs_.end())
+            continue;
+        it->second->ready |= toEvents(evs[i].events);
+        if (evs[i].events & (EPOLLRDHUP | EPOLLHUP))
+            it->second->hup = true;
+        enqueue(it->second.get());
+    }
+    runPending();
+}
+
+void EpollReactor::onCheck(ev::check &w, int revents) {
+    if (!pending_.empty())
+        runPending();
+}
+
+}
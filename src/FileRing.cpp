@@ -0,0 +1,317 @@
+#include <futures/io/FileRing.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+
+namespace futures {
+namespace io {
+
+static int sysSetup(unsigned entries, io_uring_params *p) {
+    return (int)::syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sysEnter(int fd, unsigned to_submit, unsigned min_complete,
+        unsigned flags) {
+    return (int)::syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+            flags, nullptr, 0);
+}
+
+static int sysRegister(int fd, unsigned opcode, const void *arg, unsigned nr) {
+    return (int)::syscall(__NR_io_uring_register, fd, opcode, arg, nr);
+}
+
+template <typename T>
+static T *ringPtr(void *base, uint32_t off) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + off);
+}
+
+// whether the kernel knows every opcode the ring submits, io_uring_setup
+// alone succeeds on kernels older than OPENAT, CLOSE, READ and WRITE
+static bool probeOps(int ring_fd) {
+    static const uint8_t kOps[] = {
+        IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READV, IORING_OP_WRITEV,
+        IORING_OP_FSYNC, IORING_OP_OPENAT, IORING_OP_CLOSE,
+    };
+    const unsigned nr = 256;
+    std::vector<char> mem(sizeof(io_uring_probe) + nr * sizeof(io_uring_probe_op));
+    auto probe = reinterpret_cast<io_uring_probe*>(mem.data());
+    if (sysRegister(ring_fd, IORING_REGISTER_PROBE, probe, nr) < 0) {
+        FUTURES_DLOG(INFO) << "io_uring probe: " << strerror(errno);
+        return false;
+    }
+    for (auto op : kOps) {
+        if (op > probe->last_op || op >= probe->ops_len
+                || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            FUTURES_DLOG(INFO) << "io_uring lacks opcode " << (int)op;
+            return false;
+        }
+    }
+    return true;
+}
+
+FileRing::Ptr FileRing::create(EventExecutor *ev, unsigned entries) {
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int ring_fd = sysSetup(entries, &p);
+    if (ring_fd < 0) {
+        FUTURES_DLOG(INFO) << "io_uring_setup: " << strerror(errno);
+        return nullptr;
+    }
+    if (!probeOps(ring_fd)) {
+        ::close(ring_fd);
+        return nullptr;
+    }
+    int event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0
+            || sysRegister(ring_fd, IORING_REGISTER_EVENTFD, &event_fd, 1) < 0) {
+        FUTURES_LOG(WARNING) << "io_uring eventfd: " << strerror(errno);
+        if (event_fd >= 0) ::close(event_fd);
+        ::close(ring_fd);
+        return nullptr;
+    }
+    auto ring = std::make_shared<FileRing>(ev, ring_fd, event_fd, entries);
+    if (!ring->mapRings(&p))
+        return nullptr;
+    return ring;
+}
+
+FileRing::FileRing(EventExecutor *ev, int ring_fd, int event_fd, unsigned entries)
+    : IOObject(ev), ring_fd_(ring_fd), event_fd_(event_fd), eio_(ev->getLoop()) {
+    eio_.set<FileRing, &FileRing::onEvent>(this);
+    eio_.set(event_fd_, ev::READ);
+    eio_.start();
+}
+
+bool FileRing::mapRings(const void *params) {
+    auto p = static_cast<const io_uring_params*>(params);
+    sq_ring_size_ = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    cq_ring_size_ = p->cq_off.cqes + p->cq_entries * sizeof(io_uring_cqe);
+    const bool single = p->features & IORING_FEAT_SINGLE_MMAP;
+    if (single)
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+    void *sq = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED)
+        goto fail;
+    sq_ring_ = sq;
+    if (single) {
+        cq_ring_ = sq_ring_;
+    } else {
+        void *cq = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED)
+            goto fail;
+        cq_ring_ = cq;
+    }
+    sqes_size_ = p->sq_entries * sizeof(io_uring_sqe);
+    {
+        void *sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            goto fail;
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+    }
+
+    sq_head_ = ringPtr<unsigned>(sq_ring_, p->sq_off.head);
+    sq_tail_ = ringPtr<unsigned>(sq_ring_, p->sq_off.tail);
+    sq_array_ = ringPtr<unsigned>(sq_ring_, p->sq_off.array);
+    sq_mask_ = *ringPtr<unsigned>(sq_ring_, p->sq_off.ring_mask);
+    sq_entries_ = p->sq_entries;
+    cq_head_ = ringPtr<unsigned>(cq_ring_, p->cq_off.head);
+    cq_tail_ = ringPtr<unsigned>(cq_ring_, p->cq_off.tail);
+    cqes_ = ringPtr<void>(cq_ring_, p->cq_off.cqes);
+    cq_mask_ = *ringPtr<unsigned>(cq_ring_, p->cq_off.ring_mask);
+    cq_entries_ = p->cq_entries;
+    return true;
+
+fail:
+    FUTURES_LOG(WARNING) << "io_uring mmap: " << strerror(errno);
+    return false;
+}
+
+FileRing::~FileRing() {
+    cancelLoopCallback();
+    eio_.stop();
+    // the kernel may still write into buffers owned by in-flight tokens
+    if (sqes_) {
+        submit(false);
+        while (inflight_ > 0) {
+            if (sysEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0
+                    && errno != EINTR)
+                break;
+            reap();
+        }
+    }
+    if (sqes_)
+        ::munmap(sqes_, sqes_size_);
+    if (cq_ring_ && cq_ring_ != sq_ring_)
+        ::munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_)
+        ::munmap(sq_ring_, sq_ring_size_);
+    ::close(event_fd_);
+    ::close(ring_fd_);
+}
+
+FileRing::TokenPtr FileRing::prepare(const char *what, io_uring_sqe **sqe) {
+    // keep completions within the CQ ring
+    while (inflight_ + unsubmitted_ >= cq_entries_) {
+        submit(true);
+        reap();
+    }
+    unsigned tail = *sq_tail_;
+    if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+        submit(false);
+        tail = *sq_tail_;
+    }
+    unsigned idx = tail & sq_mask_;
+    *sqe = &sqes_[idx];
+    memset(*sqe, 0, sizeof(io_uring_sqe));
+    sq_array_[idx] = idx;
+
+    TokenPtr tok(new CompletionToken(what));
+    tok->attach(this);
+    // released once the completion is reaped
+    tok->addRef();
+    (*sqe)->user_data = reinterpret_cast<uint64_t>(tok.get());
+
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    unsubmitted_++;
+    getExecutor()->runBeforePoll(this);
+    return tok;
+}
+
+void FileRing::submit(bool wait) {
+    while (unsubmitted_ > 0 || wait) {
+        int r = sysEnter(ring_fd_, unsubmitted_, wait ? 1 : 0,
+                wait ? IORING_ENTER_GETEVENTS : 0);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EBUSY) {
+                // out of kernel resources, make room by reaping
+                reap();
+                continue;
+            }
+            FUTURES_LOG(ERROR) << "io_uring_enter: " << strerror(errno);
+            return;
+        }
+        unsubmitted_ -= r;
+        inflight_ += r;
+        wait = false;
+    }
+}
+
+void FileRing::reap() {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    auto cqes = static_cast<io_uring_cqe*>(cqes_);
+    while (head != tail) {
+        auto &cqe = cqes[head & cq_mask_];
+        auto tok = reinterpret_cast<CompletionToken*>(cqe.user_data);
+        tok->res = cqe.res;
+        tok->notifyDone();
+        tok->decRef();
+        inflight_--;
+        head++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+void FileRing::onEvent(ev::io &watcher, int revent) {
+    uint64_t n;
+    while (::read(event_fd_, &n, sizeof(n)) > 0) {
+    }
+    reap();
+}
+
+FileRing::TokenPtr FileRing::read(int fd, std::unique_ptr<folly::IOBuf> buf,
+        off_t offset) {
+    io_uring_sqe *sqe;
+    auto tok = prepare("read", &sqe);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf->writableTail());
+    sqe->len = buf->tailroom();
+    sqe->off = offset;
+    tok->buf = std::move(buf);
+    return tok;
+}
+
+FileRing::TokenPtr FileRing::write(int fd, std::unique_ptr<folly::IOBuf> buf,
+        off_t offset) {
+    io_uring_sqe *sqe;
+    auto tok = prepare("write", &sqe);
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf->data());
+    sqe->len = buf->length();
+    sqe->off = offset;
+    tok->buf = std::move(buf);
+    return tok;
+}
+
+FileRing::TokenPtr FileRing::readv(int fd, std::unique_ptr<folly::IOBuf> buf,
+        std::vector<iovec> iov, off_t offset) {
+    io_uring_sqe *sqe;
+    auto tok = prepare(offset == -1 ? "readv" : "preadv", &sqe);
+    tok->buf = std::move(buf);
+    tok->iov = std::move(iov);
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(tok->iov.data());
+    sqe->len = tok->iov.size();
+    sqe->off = offset;
+    return tok;
+}
+
+FileRing::TokenPtr FileRing::writev(int fd, std::unique_ptr<folly::IOBuf> buf,
+        std::vector<iovec> iov, off_t offset) {
+    io_uring_sqe *sqe;
+    auto tok = prepare(offset == -1 ? "writev" : "pwritev", &sqe);
+    tok->buf = std::move(buf);
+    tok->iov = std::move(iov);
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(tok->iov.data());
+    sqe->len = tok->iov.size();
+    sqe->off = offset;
+    return tok;
+}
+
+FileRing::TokenPtr FileRing::fsync(int fd, bool data_only) {
+    io_uring_sqe *sqe;
+    auto tok = prepare(data_only ? "fdatasync" : "fsync", &sqe);
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = fd;
+    sqe->fsync_flags = data_only ? IORING_FSYNC_DATASYNC : 0;
+    return tok;
+}
+
+FileRing::TokenPtr FileRing::openat(const std::string &path, int flags,
+        mode_t mode) {
+    io_uring_sqe *sqe;
+    auto tok = prepare("open", &sqe);
+    tok->path = path;
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uint64_t>(tok->path.c_str());
+    sqe->len = mode;
+    sqe->open_flags = flags | O_CLOEXEC;
+    return tok;
+}
+
+FileRing::TokenPtr FileRing::close(int fd) {
+    io_uring_sqe *sqe;
+    auto tok = prepare("close", &sqe);
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    return tok;
+}
+
+}
+}
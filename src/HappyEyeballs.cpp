@@ -0,0 +1,88 @@
+#include <futures/io/HappyEyeballs.h>
+
+namespace futures {
+namespace io {
+
+constexpr double HappyEyeballsFuture::kAttemptDelay;
+
+HappyEyeballsFuture::HappyEyeballsFuture(EventExecutor *ev,
+        const dns::ResolverResult &addrs, uint16_t port, Connector connector,
+        double delay)
+    : ev_(ev), connector_(std::move(connector)), delay_(delay) {
+    for (auto &ip : interleave(addrs))
+        addrs_.emplace_back(ip, port);
+    if (!connector_) {
+        connector_ = [ev] (const folly::SocketAddress &addr) {
+            return SocketChannel::connect(ev, addr).boxed();
+        };
+    }
+}
+
+dns::ResolverResult HappyEyeballsFuture::interleave(
+        const dns::ResolverResult &addrs) {
+    dns::ResolverResult v6, v4, r;
+    for (auto &ip : addrs)
+        (ip.isV6() ? v6 : v4).push_back(ip);
+    for (size_t i = 0; i < std::max(v6.size(), v4.size()); ++i) {
+        if (i < v6.size()) r.push_back(v6[i]);
+        if (i < v4.size()) r.push_back(v4[i]);
+    }
+    return r;
+}
+
+void HappyEyeballsFuture::startNext() {
+    FUTURES_DLOG(INFO) << "connect attempt: " << addrs_[next_].describe();
+    try {
+        attempts_.push_back(connector_(addrs_[next_]));
+    } catch (std::exception &e) {
+        error_ = folly::exception_wrapper(std::current_exception(), e);
+    }
+    next_++;
+    timer_.clear();
+    if (next_ < addrs_.size())
+        timer_.emplace(ev_, delay_);
+}
+
+Poll<HappyEyeballsFuture::Item> HappyEyeballsFuture::poll() {
+    if (addrs_.empty())
+        return Poll<Item>(IOError("connect: no address"));
+    if (next_ == 0)
+        startNext();
+    while (true) {
+        for (size_t i = 0; i < attempts_.size(); ) {
+            auto r = attempts_[i].poll();
+            if (r.hasException()) {
+                error_ = r.exception();
+                attempts_.erase(attempts_.begin() + i);
+            } else if (r->isReady()) {
+                auto v = folly::moveFromTry(r);
+                auto sock = std::move(v).value();
+                // the losers close their sockets
+                attempts_.clear();
+                timer_.clear();
+                return makePollReady(std::move(sock));
+            } else {
+                ++i;
+            }
+        }
+        if (next_ >= addrs_.size()) {
+            if (attempts_.empty())
+                return Poll<Item>(error_);
+            return Poll<Item>(not_ready);
+        }
+        // all attempts failed, don't wait for the timer
+        if (attempts_.empty()) {
+            startNext();
+            continue;
+        }
+        auto t = timer_->poll();
+        if (t.hasException())
+            return Poll<Item>(t.exception());
+        if (!t->isReady())
+            return Poll<Item>(not_ready);
+        startNext();
+    }
+}
+
+}
+}
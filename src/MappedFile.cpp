@@ -0,0 +1,82 @@
+#include <futures/io/MappedFile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <system_error>
+
+namespace futures {
+namespace io {
+
+static void throwSystemError(const std::string &s) {
+    throw std::system_error(errno, std::system_category(), s);
+}
+
+static size_t pageSize() {
+    static const size_t size = ::sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+MappedFile::Ptr MappedFile::map(int fd, off_t offset, size_t length,
+        bool populate) {
+    struct stat st;
+    if (::fstat(fd, &st) < 0)
+        throwSystemError("fstat");
+    if (offset < 0 || offset > st.st_size)
+        throw std::system_error(EINVAL, std::system_category(), "mmap");
+    length = std::min<size_t>(length, st.st_size - offset);
+
+    // mmap wants a page aligned offset, map from the page start and skip
+    size_t skip = offset % pageSize();
+    size_t mapped = skip + length;
+    void *base = nullptr;
+    if (length > 0) {
+        base = ::mmap(nullptr, mapped, PROT_READ,
+                MAP_SHARED | (populate ? MAP_POPULATE : 0), fd, offset - skip);
+        if (base == MAP_FAILED)
+            throwSystemError("mmap");
+    }
+    return std::make_shared<MappedFile>(base, mapped, skip, length);
+}
+
+MappedFile::MappedFile(void *base, size_t mapped, size_t skip, size_t length)
+    : base_(base), mapped_(mapped),
+      data_(base ? static_cast<const uint8_t*>(base) + skip : nullptr),
+      length_(length) {
+}
+
+MappedFile::~MappedFile() {
+    if (base_)
+        ::munmap(base_, mapped_);
+}
+
+void MappedFile::advise(int advice, size_t offset, size_t length) {
+    if (!base_ || offset >= length_)
+        return;
+    length = std::min(length, length_ - offset);
+    // widen the range to whole pages
+    auto start = reinterpret_cast<uintptr_t>(data_ + offset);
+    auto aligned = start & ~(uintptr_t)(pageSize() - 1);
+    if (::madvise(reinterpret_cast<void*>(aligned), length + (start - aligned),
+                advice) < 0)
+        throwSystemError("madvise");
+}
+
+std::unique_ptr<folly::IOBuf> MappedFile::buffer(size_t offset, size_t length) {
+    offset = std::min(offset, length_);
+    length = std::min(length, length_ - offset);
+    if (length == 0)
+        return folly::IOBuf::create(0);
+    // each buffer holds a reference to the mapping, clones share it
+    auto buf = folly::IOBuf::takeOwnership(const_cast<uint8_t*>(data_ + offset),
+            length, &MappedFile::release, new Ptr(shared_from_this()));
+    // the pages are PROT_READ, nobody may write into them in place even
+    // holding the last reference
+    buf->markExternallyShared();
+    return buf;
+}
+
+void MappedFile::release(void *buf, void *userData) {
+    delete static_cast<Ptr*>(userData);
+}
+
+}
+}
@@ -0,0 +1,156 @@
+#include <futures/MemoryBudget.h>
+#include <futures/EventExecutor.h>
+
+namespace futures {
+
+const size_t MemoryBudget::kGlobalGranularity;
+constexpr double MemoryBudget::kRecheckInterval;
+
+static std::atomic<size_t> gUsage{0};
+static std::atomic<size_t> gLow{0};
+static std::atomic<size_t> gHigh{0};
+
+MemoryBudget::Account::~Account() {
+    // only accounts holding memory or paused are linked
+    if (!budget_ || !is_linked())
+        return;
+    budget_->detach(this);
+}
+
+MemoryBudget::~MemoryBudget() {
+    cancelLoopCallback();
+    for (auto &a : accounts_)
+        a.budget_ = nullptr;
+    accounts_.clear();
+    gUsage.fetch_sub(reported_, std::memory_order_relaxed);
+}
+
+void MemoryBudget::setWatermarks(size_t low, size_t high) {
+    assert(low <= high);
+    low_ = low;
+    high_ = high;
+    if (paused_ && underLow())
+        resumeAll();
+    else if (overHigh())
+        ev_->runBeforePoll(this);
+}
+
+void MemoryBudget::setGlobalWatermarks(size_t low, size_t high) {
+    assert(low <= high);
+    gLow.store(low, std::memory_order_relaxed);
+    gHigh.store(high, std::memory_order_relaxed);
+}
+
+size_t MemoryBudget::getGlobalUsage() {
+    return gUsage.load(std::memory_order_relaxed);
+}
+
+void MemoryBudget::charge(Account *a, ssize_t delta) {
+    if (!delta)
+        return;
+    if (!a->is_linked()) {
+        a->budget_ = this;
+        accounts_.push_back(*a);
+    }
+    assert(delta > 0 || a->usage_ >= (size_t)-delta);
+    a->usage_ += delta;
+    usage_ += delta;
+    report();
+    // idle channels stay out of the scans
+    if (!a->usage_ && !a->paused_)
+        a->unlink();
+    if (delta > 0) {
+        if (overHigh())
+            ev_->runBeforePoll(this);
+    } else if (paused_ && underLow()) {
+        resumeAll();
+    }
+}
+
+void MemoryBudget::detach(Account *a) {
+    // not a candidate for pausing or resuming anymore
+    a->unlink();
+    if (a->paused_) {
+        a->paused_ = false;
+        paused_--;
+    }
+    usage_ -= a->usage_;
+    a->usage_ = 0;
+    report();
+    if (paused_ && underLow())
+        resumeAll();
+}
+
+void MemoryBudget::report() {
+    // keep the shared counter off the fast path
+    if (usage_ >= reported_ + kGlobalGranularity) {
+        gUsage.fetch_add(usage_ - reported_, std::memory_order_relaxed);
+        reported_ = usage_;
+    } else if (usage_ + kGlobalGranularity <= reported_) {
+        gUsage.fetch_sub(reported_ - usage_, std::memory_order_relaxed);
+        reported_ = usage_;
+    }
+}
+
+bool MemoryBudget::overHigh() const {
+    size_t global_high = gHigh.load(std::memory_order_relaxed);
+    return (high_ && usage_ >= high_)
+        || (global_high && getGlobalUsage() >= global_high);
+}
+
+bool MemoryBudget::underLow() const {
+    size_t global_high = gHigh.load(std::memory_order_relaxed);
+    return (!high_ || usage_ <= low_)
+        && (!global_high
+                || getGlobalUsage() <= gLow.load(std::memory_order_relaxed));
+}
+
+void MemoryBudget::runLoopCallback() {
+    if (!overHigh())
+        return;
+    Account *heaviest = nullptr;
+    for (auto &a : accounts_) {
+        if (!a.paused_ && a.usage_ > 0
+                && (!heaviest || a.usage_ > heaviest->usage_))
+            heaviest = &a;
+    }
+    if (!heaviest)
+        return;
+    heaviest->paused_ = true;
+    paused_++;
+    pauses_++;
+    heaviest->pauseReading();
+    scheduleRecheck();
+}
+
+void MemoryBudget::scheduleRecheck() {
+    if (recheck_.isArmed())
+        return;
+    auto &q = ev_->getDeadlines();
+    q.schedule(&recheck_, q.now() + kRecheckInterval);
+}
+
+void MemoryBudget::recheck() {
+    if (!paused_)
+        return;
+    if (underLow())
+        resumeAll();
+    else
+        scheduleRecheck();
+}
+
+void MemoryBudget::resumeAll() {
+    for (auto it = accounts_.begin(); it != accounts_.end(); ) {
+        auto &a = *it++;
+        if (!a.paused_)
+            continue;
+        a.paused_ = false;
+        // only linked for being paused
+        if (!a.usage_)
+            a.unlink();
+        a.resumeReading();
+    }
+    paused_ = 0;
+}
+
+}
@@ -1,4 +1,6 @@
 #include <futures/io/PipeChannel.h>
+#include <sys/uio.h>
+#include <climits>
 
 namespace futures {
 namespace io {
@@ -36,8 +38,18 @@ io::intrusive_ptr<WriterCompletionToken> PipeChannel::doWrite(std::unique_ptr<Wr
 {
     if (!wfd_) throw IOError("Read-only pipe.");
     io::intrusive_ptr<WriterCompletionToken> tok(p.release());
+    if (s_ == CLOSED) {
+        tok->writeError(std::make_error_code(std::errc::broken_pipe));
+        return tok;
+    }
+    bool idle = getPending(IOObject::OpWrite).empty();
     tok->attach(this);
-    wio_.start();
+    writeQueued(tok.get());
+    // try write immediately, only wait for the watcher on EAGAIN
+    if (idle)
+        handleWrite();
+    else
+        wio_.start();
     return tok;
 }
 
@@ -48,56 +60,79 @@ ssize_t PipeChannel::performWrite(
         size_t* partialWritten,
         std::error_code &ec)
 {
-    throw std::runtime_error("unimpl");
+again:
+    ssize_t totalWritten = ::writev(wfd_.fd(), vec, std::min<size_t>(count, IOV_MAX));
+    if (totalWritten < 0) {
+        if (errno == EINTR)
+            goto again;
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            ec = std::error_code(errno, std::system_category());
+        *countWritten = 0;
+        *partialWritten = 0;
+        return 0;
+    }
+
+    size_t bytesWritten;
+    size_t n;
+    for (bytesWritten = totalWritten, n = 0; n < count; ++n) {
+        const iovec* v = vec + n;
+        if (v->iov_len > bytesWritten) {
+            *countWritten = n;
+            *partialWritten = bytesWritten;
+            return totalWritten;
+        }
+
+        bytesWritten -= v->iov_len;
+    }
+
+    assert(bytesWritten == 0);
+    *countWritten = n;
+    *partialWritten = 0;
+    return totalWritten;
 }
 
-void PipeChannel::onEvent(ev::io& watcher, int revent) {
-    if (wfd_ && (revent & ev::WRITE)) {
-        if (s_ == CLOSED) {
-            failAllWrites();
-            return;
+void PipeChannel::handleWrite() {
+    auto &writer = getPending(IOObject::OpWrite);
+    while (!writer.empty()) {
+        auto p = static_cast<WriterCompletionToken*>(&writer.front());
+        std::error_code ec;
+        iovec *vec;
+        size_t vecLen = 0;
+        p->prepareIov(&vec, &vecLen);
+        if (!vecLen) {
+            p->notifyDone();
+            continue;
         }
-        auto &writer = getPending(IOObject::OpWrite);
-        while (!writer.empty()) {
-            auto p = static_cast<WriterCompletionToken*>(&writer.front());
-            std::error_code ec;
-            iovec *vec;
-            size_t vecLen = 0;
-            p->prepareIov(&vec, &vecLen);
-            if (!vecLen) {
+        size_t countWritten;
+        size_t partialWritten;
+        ssize_t totalWritten = performWrite(vec, vecLen,
+                &countWritten, &partialWritten, ec);
+        if (!ec) {
+            p->updateIov(totalWritten, countWritten, partialWritten);
+            if (countWritten == vecLen) {
                 p->notifyDone();
-                continue;
-            }
-            size_t countWritten;
-            size_t partialWritten;
-            ssize_t totalWritten = performWrite(vec, vecLen,
-                    &countWritten, &partialWritten, ec);
-            if (!ec) {
-                p->updateIov(totalWritten, countWritten, partialWritten);
-                if (countWritten == vecLen) {
-                    p->notifyDone();
-#if 0
-                    if (shutdown_flags_ & SHUT_WRITE_PENDING) {
-                        shutdownWriteNow();
-                        break;
-                    }
-#endif
-                } else {
-                    break;
-                }
             } else {
-                p->writeError(ec);
-                cleanup(CancelReason::IOObjectShutdown);
                 break;
             }
+        } else {
+            p->writeError(ec);
+            cleanup(CancelReason::IOObjectShutdown);
+            return;
         }
-        if (writer.empty()) {
-            wio_.stop();
-#if 0
-            if (shutdown_flags_ & SHUT_WRITE_PENDING)
-                shutdownWriteNow();
-#endif
+    }
+    if (writer.empty())
+        wio_.stop();
+    else
+        wio_.start();
+}
+
+void PipeChannel::onEvent(ev::io& watcher, int revent) {
+    if (wfd_ && (revent & ev::WRITE)) {
+        if (s_ == CLOSED) {
+            failAllWrites();
+            return;
         }
+        handleWrite();
     }
     if (rfd_ && (revent & ev::READ)) {
         auto &reader = getPending(IOObject::OpRead);
@@ -0,0 +1,210 @@
+#include <futures/io/Proxy.h>
+#include <futures/io/SigPipeGuard.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(SPLICE_F_MOVE)
+#define FUTURES_HAVE_SPLICE 1
+#endif
+
+namespace futures {
+namespace io {
+
+const size_t Proxy::kPipeSize;
+
+// bytes one direction relays per readiness event, so a busy connection
+// cannot starve the others on the same loop
+static const size_t kMaxBytesPerEvent = 256 * 1024;
+
+
+Proxy::Direction::Direction(Proxy *proxy, SocketChannel::Ptr from,
+        SocketChannel::Ptr to)
+    : proxy(proxy), from(std::move(from)), to(std::move(to)),
+      rio(proxy->getExecutor()), wio(proxy->getExecutor()) {
+    rio.set<Direction, &Direction::onEvent>(this);
+    wio.set<Direction, &Direction::onEvent>(this);
+}
+
+Proxy::Proxy(EventExecutor *ev, SocketChannel::Ptr a, SocketChannel::Ptr b,
+        size_t pipe_size)
+    : IOObject(ev), pipe_size_(pipe_size),
+      fwd_(this, a, b), bwd_(this, b, a) {
+}
+
+Proxy::~Proxy() {
+    stopSplice();
+}
+
+ProxyStats Proxy::getStats() const {
+    ProxyStats stats;
+    stats.forward = fwd_.bytes;
+    stats.backward = bwd_.bytes;
+    stats.spliced = spliced_;
+    return stats;
+}
+
+void Proxy::onCancel(CancelReason reason) {
+    stopSplice();
+}
+
+BoxedFuture<ProxyStats> Proxy::run() {
+    auto self = shared_from_this();
+    if (fwd_.from->canSplice() && fwd_.to->canSplice() && openPipes()) {
+        spliced_ = true;
+        return SpliceFuture(self).boxed();
+    }
+    return (copy(fwd_).join(copy(bwd_))
+        >> [self] (std::tuple<Unit, Unit>) {
+            return makeOk(self->getStats());
+        }).boxed();
+}
+
+bool Proxy::openPipes() {
+#ifdef FUTURES_HAVE_SPLICE
+    for (auto d : {&fwd_, &bwd_}) {
+        if (::pipe2(d->pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+            FUTURES_LOG(WARNING) << "pipe2: " << strerror(errno)
+                << ", copying instead";
+            closePipes();
+            return false;
+        }
+        // best effort, the default is 64 KiB
+        ::fcntl(d->pipe[1], F_SETPIPE_SZ, (int)pipe_size_);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Proxy::closePipes() {
+    for (auto d : {&fwd_, &bwd_}) {
+        for (int &fd : d->pipe) {
+            if (fd >= 0)
+                ::close(fd);
+            fd = -1;
+        }
+    }
+}
+
+intrusive_ptr<Proxy::SpliceToken> Proxy::startSplice() {
+    intrusive_ptr<SpliceToken> tok(new SpliceToken(this));
+    tok->attach(this);
+    tok_ = tok.get();
+    for (auto d : {&fwd_, &bwd_}) {
+        d->rio.set(d->from->fd(), ev::READ);
+        d->wio.set(d->to->fd(), ev::WRITE);
+        d->rio.start();
+    }
+    return tok;
+}
+
+void Proxy::stopSplice() {
+    tok_ = nullptr;
+    for (auto d : {&fwd_, &bwd_}) {
+        d->rio.reset();
+        d->wio.reset();
+    }
+    closePipes();
+}
+
+void Proxy::finish(folly::exception_wrapper error) {
+    auto tok = tok_;
+    if (tok) {
+        tok->stats = getStats();
+        tok->error = std::move(error);
+    }
+    stopSplice();
+    if (tok)
+        tok->notifyDone();
+}
+
+void Proxy::pump(Direction &d) {
+#ifdef FUTURES_HAVE_SPLICE
+    // splice(2) into a socket has no MSG_NOSIGNAL, a peer reset must not
+    // raise SIGPIPE
+    SigPipeGuard guard;
+    size_t budget = kMaxBytesPerEvent;
+    while (!d.done) {
+        if (d.pending > 0) {
+            ssize_t n = ::splice(d.pipe[0], nullptr, d.to->fd(), nullptr,
+                    d.pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN) {
+                    // backpressure, read again once `to' took the pipe
+                    d.rio.stop();
+                    d.wio.clearReady();
+                    d.wio.start();
+                    return;
+                }
+                finish(IOError("splice", std::error_code(errno, std::system_category())));
+                return;
+            }
+            d.pending -= n;
+            d.bytes += n;
+            if ((size_t)n >= budget) {
+                // budget used up, the watcher fires again next loop
+                if (d.pending > 0) {
+                    d.rio.stop();
+                    d.wio.start();
+                } else {
+                    d.wio.stop();
+                    d.rio.start();
+                }
+                return;
+            }
+            budget -= n;
+            continue;
+        }
+        if (d.eof) {
+            d.done = true;
+            d.rio.stop();
+            d.wio.stop();
+            d.to->shutdownWrite();
+            if (fwd_.done && bwd_.done)
+                finish(folly::exception_wrapper());
+            return;
+        }
+        // the pipe is empty, so EAGAIN means the socket is
+        ssize_t n = ::splice(d.from->fd(), nullptr, d.pipe[1], nullptr,
+                pipe_size_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n == 0) {
+            d.eof = true;
+        } else if (n > 0) {
+            d.pending = n;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN) {
+            d.wio.stop();
+            d.rio.clearReady();
+            d.rio.start();
+            return;
+        } else {
+            finish(IOError("splice", std::error_code(errno, std::system_category())));
+            return;
+        }
+    }
+#endif
+}
+
+BoxedFuture<Unit> Proxy::copy(Direction &d) {
+    auto self = shared_from_this();
+    auto dir = &d;
+    auto to = d.to;
+    return (d.from->readStream()
+        .andThen([to] (std::unique_ptr<folly::IOBuf> buf) {
+            return to->write(std::move(buf));
+        })
+        .forEach([self, dir] (ssize_t n) {
+            dir->bytes += n;
+        })
+        >> [to] (Unit) {
+            to->shutdownWrite();
+            return makeOk();
+        }).boxed();
+}
+
+}
+}
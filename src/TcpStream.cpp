@@ -3,7 +3,11 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <climits>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 extern "C" {
 #include "libae/anet.h"
@@ -52,16 +56,43 @@ void Socket::shutdown(int how, std::error_code &ec) noexcept {
 bool Socket::connect(const folly::SocketAddress &addr, std::error_code &ec)
 {
     if (addr.getFamily() == AF_INET
-        || addr.getFamily() == AF_INET6) {
-        return connectIP(addr.getAddressStr(), addr.getPort(), ec);
-    } else if (addr.getFamily() == AF_UNIX) {
-        return connectUnix(addr.getPath(), ec);
+        || addr.getFamily() == AF_INET6
+        || addr.getFamily() == AF_UNIX) {
+        // AF_UNIX includes the abstract namespace, which connectUnix()
+        // cannot express
+        return connect(addr, SocketOptions(), ec);
     } else {
         ec = std::make_error_code(std::errc::protocol_not_supported);
         return false;
     }
 }
 
+bool Socket::connect(const folly::SocketAddress &addr,
+        const SocketOptions &opts, std::error_code &ec)
+{
+    open(addr.getFamily(), ec);
+    if (ec) return false;
+    applyOptions(opts, ec);
+    if (ec) {
+        close();
+        return false;
+    }
+    setNoSigPipe(fd_);
+    struct sockaddr_storage sa;
+    socklen_t salen = addr.getAddress(&sa);
+again:
+    if (::connect(fd_, (struct sockaddr*)&sa, salen) < 0) {
+        if (errno == EINTR)
+            goto again;
+        if (errno == EINPROGRESS)
+            return false;
+        ec = current_system_error();
+        close();
+        return false;
+    }
+    return true;
+}
+
 bool Socket::connectUnix(const std::string &path, std::error_code &ec)
 {
     char buf[ANET_ERR_LEN];
@@ -134,7 +165,7 @@ ssize_t Socket::writev(const iovec *vec, size_t veclen, int flags, std::error_co
     msg.msg_controllen = 0;
     msg.msg_flags = 0;
 
-    int msg_flags = MSG_DONTWAIT;
+    int msg_flags = MSG_DONTWAIT | flags;
 
 #ifdef MSG_NOSIGNAL
     msg_flags |= MSG_NOSIGNAL;
@@ -173,6 +204,116 @@ again:
     }
 }
 
+ssize_t Socket::readv(const iovec *vec, size_t veclen, std::error_code &ec)
+{
+    assert(fd_ >= 0);
+again:
+    ssize_t l = ::readv(fd_, vec, std::min<size_t>(veclen, IOV_MAX));
+    if (l == -1) {
+        if (errno == EINTR)
+            goto again;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            ec = std::make_error_code(std::errc::operation_would_block);
+        } else {
+            ec = current_system_error();
+        }
+        return 0;
+    } else {
+        return l;
+    }
+}
+
+// descriptors per SCM_RIGHTS message, the kernel limit (SCM_MAX_FD)
+static const size_t kMaxPassedFds = 253;
+
+ssize_t Socket::sendWithFds(const iovec *vec, size_t veclen,
+        const std::vector<int> &fds, std::error_code &ec)
+{
+    assert(fd_ >= 0);
+    if (fds.size() > kMaxPassedFds) {
+        ec = std::make_error_code(std::errc::argument_list_too_long);
+        return 0;
+    }
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = const_cast<iovec*>(vec);
+    msg.msg_iovlen = std::min<size_t>(veclen, IOV_MAX);
+    if (!fds.empty()) {
+        msg.msg_control = control.data();
+        msg.msg_controllen = control.size();
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        memcpy(CMSG_DATA(cm), fds.data(), sizeof(int) * fds.size());
+    }
+
+    int msg_flags = MSG_DONTWAIT;
+#ifdef MSG_NOSIGNAL
+    msg_flags |= MSG_NOSIGNAL;
+#endif
+
+again:
+    ssize_t sent = ::sendmsg(fd_, &msg, msg_flags);
+    if (sent < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        if (errno == EINTR)
+            goto again;
+        ec = current_system_error();
+        return 0;
+    }
+    return sent;
+}
+
+ssize_t Socket::recvWithFds(void *buf, size_t len, std::vector<int> *fds,
+        std::error_code &ec)
+{
+    assert(fd_ >= 0);
+    struct iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxPassedFds)];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    int flags = 0;
+#ifdef MSG_CMSG_CLOEXEC
+    flags |= MSG_CMSG_CLOEXEC;
+#endif
+again:
+    ssize_t l = ::recvmsg(fd_, &msg, flags);
+    if (l == -1) {
+        if (errno == EINTR)
+            goto again;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            ec = std::make_error_code(std::errc::operation_would_block);
+        } else {
+            ec = current_system_error();
+        }
+        return 0;
+    }
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+            continue;
+        size_t n = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const int *p = reinterpret_cast<const int*>(CMSG_DATA(cm));
+        for (size_t i = 0; i < n; ++i) {
+            int fd;
+            memcpy(&fd, p + i, sizeof(fd));
+            fds->push_back(fd);
+        }
+    }
+    if (msg.msg_flags & MSG_CTRUNC)
+        FUTURES_LOG(WARNING) << "passed descriptors truncated";
+    return l;
+}
+
 void Socket::tcpServer(const std::string& bindaddr, uint16_t port,
         int backlog, std::error_code &ec) {
     assert(fd_ < 0);
@@ -198,12 +339,126 @@ void Socket::tcpServer(const std::string& bindaddr, uint16_t port,
     }
 }
 
+void Socket::open(int family, std::error_code &ec) {
+    assert(fd_ < 0);
+#ifdef SOCK_NONBLOCK
+    int fd = ::socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+#else
+    int fd = ::socket(family, SOCK_STREAM, 0);
+#endif
+    if (fd < 0) {
+        ec = current_system_error();
+        return;
+    }
+    fd_ = fd;
+#ifndef SOCK_NONBLOCK
+    char buf[ANET_ERR_LEN];
+    if (anetNonBlock(buf, fd) || ::fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+        ec = current_system_error();
+        close();
+    }
+#endif
+}
+
+void Socket::setOption(int level, int name, int value, std::error_code &ec) {
+    if (::setsockopt(fd_, level, name, &value, sizeof(value)) < 0)
+        ec = current_system_error();
+}
+
+void Socket::bind(const folly::SocketAddress &addr, std::error_code &ec) {
+    struct sockaddr_storage sa;
+    socklen_t salen = addr.getAddress(&sa);
+    if (::bind(fd_, (struct sockaddr*)&sa, salen) < 0)
+        ec = current_system_error();
+}
+
+void Socket::listen(int backlog, std::error_code &ec) {
+    if (::listen(fd_, backlog) < 0)
+        ec = current_system_error();
+}
+
+folly::SocketAddress Socket::getLocalAddress() const {
+    folly::SocketAddress addr;
+    addr.setFromLocalAddress(fd_);
+    return addr;
+}
+
+void Socket::applyOptions(const SocketOptions &opts, std::error_code &ec) {
+    struct sockaddr_storage sa;
+    socklen_t salen = sizeof(sa);
+    if (::getsockname(fd_, (struct sockaddr*)&sa, &salen) < 0) {
+        ec = current_system_error();
+        return;
+    }
+    const bool ip = sa.ss_family == AF_INET || sa.ss_family == AF_INET6;
+    auto set = [&] (bool apply, int level, int name, int value) {
+        if (apply && !ec) setOption(level, name, value, ec);
+    };
+
+    set(opts.send_buffer.hasValue(), SOL_SOCKET, SO_SNDBUF, opts.send_buffer.value_or(0));
+    set(opts.recv_buffer.hasValue(), SOL_SOCKET, SO_RCVBUF, opts.recv_buffer.value_or(0));
+    set(opts.keep_alive.hasValue(), SOL_SOCKET, SO_KEEPALIVE, opts.keep_alive.value_or(false));
+#ifdef SO_BUSY_POLL
+    set(opts.busy_poll.hasValue(), SOL_SOCKET, SO_BUSY_POLL, opts.busy_poll.value_or(0));
+#endif
+    if (!ip) return;
+
+    set(opts.no_delay.hasValue(), IPPROTO_TCP, TCP_NODELAY, opts.no_delay.value_or(false));
+#ifdef TCP_KEEPIDLE
+    set(opts.keep_idle.hasValue(), IPPROTO_TCP, TCP_KEEPIDLE, opts.keep_idle.value_or(0));
+    set(opts.keep_interval.hasValue(), IPPROTO_TCP, TCP_KEEPINTVL, opts.keep_interval.value_or(0));
+    set(opts.keep_count.hasValue(), IPPROTO_TCP, TCP_KEEPCNT, opts.keep_count.value_or(0));
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+    set(opts.not_sent_lowat.hasValue(), IPPROTO_TCP, TCP_NOTSENT_LOWAT, opts.not_sent_lowat.value_or(0));
+#endif
+#ifdef TCP_USER_TIMEOUT
+    set(opts.user_timeout.hasValue(), IPPROTO_TCP, TCP_USER_TIMEOUT, opts.user_timeout.value_or(0));
+#endif
+    if (sa.ss_family == AF_INET6)
+        set(opts.tos.hasValue(), IPPROTO_IPV6, IPV6_TCLASS, opts.tos.value_or(0));
+    else
+        set(opts.tos.hasValue(), IPPROTO_IP, IP_TOS, opts.tos.value_or(0));
+}
+
+TcpInfo Socket::getTcpInfo(std::error_code &ec) const {
+    TcpInfo info;
+#ifdef TCP_INFO
+    struct tcp_info ti;
+    socklen_t len = sizeof(ti);
+    memset(&ti, 0, sizeof(ti));
+    if (::getsockopt(fd_, IPPROTO_TCP, TCP_INFO, &ti, &len) < 0) {
+        ec = current_system_error();
+        return info;
+    }
+    info.state = ti.tcpi_state;
+    info.rtt_us = ti.tcpi_rtt;
+    info.rttvar_us = ti.tcpi_rttvar;
+    info.snd_cwnd = ti.tcpi_snd_cwnd;
+    info.snd_ssthresh = ti.tcpi_snd_ssthresh;
+    info.snd_mss = ti.tcpi_snd_mss;
+    info.rcv_mss = ti.tcpi_rcv_mss;
+    info.unacked = ti.tcpi_unacked;
+    info.lost = ti.tcpi_lost;
+    info.retransmits = ti.tcpi_retransmits;
+    info.total_retrans = ti.tcpi_total_retrans;
+#else
+    ec = std::make_error_code(std::errc::operation_not_supported);
+#endif
+    return info;
+}
+
 Socket Socket::accept(std::error_code& ec, folly::SocketAddress *peer) {
     struct sockaddr_storage sa;
     socklen_t salen = sizeof(sa);
     int fd;
 again:
+#ifdef SOCK_NONBLOCK
+    // saves the fcntl calls for the flags
+    fd = ::accept4(fd_, (struct sockaddr*)&sa, &salen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
     fd = ::accept(fd_, (struct sockaddr*)&sa, &salen);
+#endif
     if (fd == -1) {
         if (errno == EINTR) {
             goto again;
@@ -215,18 +470,21 @@ again:
         }
     } else {
         char buf[ANET_ERR_LEN];
+#ifndef SOCK_NONBLOCK
         if (anetNonBlock(buf, fd)) {
             ec = current_system_error();
             ::close(fd);
             return Socket();
         }
-        if (anetEnableTcpNoDelay(buf, fd)) {
+#endif
+        if (sa.ss_family != AF_UNIX && anetEnableTcpNoDelay(buf, fd)) {
             ec = current_system_error();
             ::close(fd);
             return Socket();
         }
-    	setNoSigPipe(fd_);
-        peer->setFromSockaddr((struct sockaddr*)&sa);
+        setNoSigPipe(fd);
+        if (peer)
+            peer->setFromSockaddr((struct sockaddr*)&sa, salen);
         return Socket(fd);
     }
 }
@@ -43,29 +43,96 @@ HttpClient::HttpClient(EventExecutor *ev, io::SSLContext *ctx, dns::AsyncResolve
     : ev_(ev), ssl_ctx_(ctx), resolver_(resolver), host_(url) {
 }
 
-BoxedFuture<folly::IPAddress> HttpClient::resolve() {
-    if (folly::IPAddress::validate(host_.host)) {
-        return makeOk(folly::IPAddress(host_.host));
+HttpClient::HttpClient(EventExecutor *ev, Pool::Ptr pool, const Url &url)
+    : ev_(ev), host_(url), pool_(std::move(pool)) {
+    if (!host_.unix_path.empty())
+        throw std::invalid_argument("not support");
+}
+
+HttpClient::Connection::Connection(EventExecutor *ev, io::SocketChannel::Ptr sock)
+    : sock_(sock), client_(spawnDispatcher(ev, sock)) {
+}
+
+HttpClient::Connection::~Connection() {
+    client_->close();
+}
+
+std::string HttpClient::poolKey(const Url &url) {
+    return url.schema + "://" + url.host + ":" + std::to_string(url.port);
+}
+
+HttpClient::Pool::Ptr HttpClient::makePool(EventExecutor *ev,
+        dns::AsyncResolver::Ptr resolver, io::SSLContext *ctx,
+        const Pool::Options &opts) {
+    return std::make_shared<Pool>(ev,
+        [ev, resolver, ctx] (const std::string &key) {
+            auto url = parseUrl(key);
+            if (url.schema == "https" && !ctx)
+                throw std::invalid_argument("not support");
+            return (connectTo(ev, ctx, resolver, url)
+                | [ev] (io::SocketChannel::Ptr sock) {
+                    return std::make_shared<Connection>(ev, sock);
+                }).boxed();
+        }, opts,
+        [] (Connection &conn) {
+            return conn.good();
+        });
+}
+
+BoxedFuture<dns::ResolverResult> HttpClient::resolve(
+        dns::AsyncResolver::Ptr resolver, const std::string &host) {
+    if (folly::IPAddress::validate(host)) {
+        return makeOk(dns::ResolverResult{folly::IPAddress(host)});
     }
-    return resolver_->resolve(host_.host, dns::AsyncResolver::EnableTypeA4)
-        | [] (dns::ResolverResult res) {
-            return res[0];
+    // both families, raced by connectTo()
+    return resolver->resolve(host,
+            dns::AsyncResolver::EnableTypeA4 | dns::AsyncResolver::EnableTypeA6);
+}
+
+BoxedFuture<io::SocketChannel::Ptr> HttpClient::connectTo(EventExecutor *ev,
+        io::SSLContext *ctx, dns::AsyncResolver::Ptr resolver, const Url &url) {
+    io::HappyEyeballsFuture::Connector connector;
+    if (url.schema == "https") {
+        connector = [ev, ctx] (const folly::SocketAddress &addr) {
+            return (io::SSLSocketChannel::connect(ev, ctx, addr)
+                | [] (io::SSLSocketChannel::Ptr sock) {
+                    return io::SocketChannel::Ptr(sock);
+                }).boxed();
         };
+    }
+    uint16_t port = url.port;
+    return (resolve(resolver, url.host)
+        >> [ev, port, connector] (dns::ResolverResult addrs) {
+            return io::connectHappyEyeballs(ev, addrs, port, connector);
+        }).boxed();
 }
 
-void HttpClient::spawnClient(io::SocketChannel::Ptr sock) {
-    sock_ = sock;
-    client_ = std::make_shared<dispatcher_type>();
-    ev_->spawn(makeRpcClientFuture(
+std::shared_ptr<HttpClient::dispatcher_type>
+HttpClient::spawnDispatcher(EventExecutor *ev, io::SocketChannel::Ptr sock) {
+    auto client = std::make_shared<dispatcher_type>();
+    ev->spawn(makeRpcClientFuture(
         sock,
         io::FramedStream<http::Response>(sock, std::make_shared<http::HttpV1ResponseDecoder>()),
         io::FramedSink<http::Request>(sock, std::make_shared<http::HttpV1RequestEncoder>()),
-        client_)
+        client)
     );
+    return client;
+}
+
+void HttpClient::spawnClient(io::SocketChannel::Ptr sock) {
+    sock_ = sock;
+    client_ = spawnDispatcher(ev_, sock);
 }
 
 
 BoxedFuture<Unit> HttpClient::connect() {
+    if (pool_) {
+        // leaves a connection idle in the pool
+        return pool_->checkout(poolKey(host_))
+            | [] (Pool::Lease lease) {
+                return unit;
+            };
+    }
     if (client_ && sock_->good()) {
         return makeOk();
     } else {
@@ -74,30 +141,30 @@ BoxedFuture<Unit> HttpClient::connect() {
     if (isSSL() && !ssl_ctx_)
         throw std::invalid_argument("not support");
     auto self = shared_from_this();
-    if (!isSSL()) {
-         return (resolve()
-             >> [self] (folly::IPAddress ip) {
-                 folly::SocketAddress addr(ip, self->host_.port);
-                 return io::SocketChannel::connect(self->ev_, addr);
-             })
-             | [self] (io::SocketChannel::Ptr sock) {
-                 self->spawnClient(sock);
-                 return unit;
-             };
-    } else {
-        return (resolve()
-            >> [self] (folly::IPAddress ip) {
-                 folly::SocketAddress addr(ip, self->host_.port);
-                 return io::SSLSocketChannel::connect(self->ev_, self->ssl_ctx_, addr);
-            })
-            | [self] (io::SSLSocketChannel::Ptr sock) {
+    if (!host_.unix_path.empty()) {
+        if (isSSL())
+            throw std::invalid_argument("not support");
+        folly::SocketAddress addr;
+        addr.setFromPath(host_.unix_path);
+        return io::SocketChannel::connect(ev_, addr)
+            | [self] (io::SocketChannel::Ptr sock) {
                 self->spawnClient(sock);
                 return unit;
             };
     }
+    return connectTo(ev_, ssl_ctx_, resolver_, host_)
+        | [self] (io::SocketChannel::Ptr sock) {
+            self->spawnClient(sock);
+            return unit;
+        };
 }
 
 BoxedFuture<Unit> HttpClient::close() {
+    if (pool_) {
+        // the connections belong to the pool
+        closing_ = true;
+        return makeOk();
+    }
     if (!client_ || closing_) return makeOk();
     closing_ = true;
     sock_.reset();
@@ -106,6 +173,8 @@ BoxedFuture<Unit> HttpClient::close() {
 
 BoxedFuture<Response> HttpClient::request(http::Request&& req) {
     if (closing_) throw IOError("HttpClient closed");
+    if (pool_)
+        return pooledRequest(std::move(req));
     auto self = shared_from_this();
     auto w = folly::makeMoveWrapper(std::move(req));
     return connect()
@@ -122,6 +191,23 @@ BoxedFuture<Response> HttpClient::request(http::Request&& req) {
         };
 }
 
+BoxedFuture<Response> HttpClient::pooledRequest(http::Request&& req) {
+    auto w = folly::makeMoveWrapper(std::move(req));
+    return pool_->checkout(poolKey(host_))
+        >> [w] (Pool::Lease lease) {
+            // a connection failing the request is not good() anymore and
+            // the pool drops it
+            auto l = std::make_shared<Pool::Lease>(std::move(lease));
+            return (**l)(w.move())
+                >> [l] (Response resp) {
+                    auto it = resp.headers.find("Connection");
+                    if (it != resp.headers.end() && it->second == "close")
+                        l->discard();
+                    return makeOk(std::move(resp));
+                };
+        };
+}
+
 void HttpClient::fillHeaders(HttpClient::HeaderFields &headers) {
     headers["Host"] = host_.host;
     if (!user_agent_.empty())
@@ -1,6 +1,9 @@
 #include <gtest/gtest.h>
 #include <futures/Timer.h>
 #include <futures/io/AsyncFile.h>
+#include <futures/io/MappedFile.h>
+#include <futures/io/AppendLog.h>
+#include <unistd.h>
 
 using namespace futures;
 
@@ -35,3 +38,277 @@ TEST(File, Error) {
     EXPECT_THROW(f->openSync("/NOT_EXISTS/PATH/xxx", O_RDONLY), std::system_error);
 }
 
+
+TEST(File, Ring) {
+    EventExecutor ev;
+    auto ring = io::FileRing::create(&ev);
+    if (!ring) {
+        std::cout << "io_uring unavailable" << std::endl;
+        return;
+    }
+    auto path = "/tmp/futures_ring_" + std::to_string(getpid());
+    auto f = std::make_shared<io::AsyncFile>(ring);
+    std::string data;
+    ev.spawn(f->open(path, O_RDWR | O_CREAT | O_TRUNC)
+        >> [f] (Unit) {
+            return f->write(folly::IOBuf::copyBuffer("hello ring"));
+        }
+        >> [f] (ssize_t n) {
+            return f->fsync(true);
+        }
+        >> [f, path] (Unit) {
+            f->closeSync();
+            return f->open(path, O_RDONLY);
+        }
+        >> [f] (Unit) {
+            return f->read(128);
+        }
+        >> [f, &data] (std::unique_ptr<folly::IOBuf> buf) {
+            data = buf->coalesce().toString();
+            return f->close();
+        });
+    ev.run();
+    EXPECT_EQ(data, "hello ring");
+    EXPECT_FALSE(f->isValid());
+    EXPECT_EQ(ring->inflight(), 0u);
+
+    // errors surface like the thread pool ones
+    bool failed = false;
+    ev.spawn(f->open("/NOT_EXISTS/PATH/xxx", O_RDONLY)
+        .error([&failed] (folly::exception_wrapper w) {
+            failed = w.is_compatible_with<std::system_error>();
+        }));
+    ev.run();
+    EXPECT_TRUE(failed);
+    ::unlink(path.c_str());
+}
+
+TEST(File, RingConcurrent) {
+    EventExecutor ev;
+    auto ring = io::FileRing::create(&ev);
+    if (!ring) {
+        std::cout << "io_uring unavailable" << std::endl;
+        return;
+    }
+    auto path = "/tmp/futures_ring_n_" + std::to_string(getpid());
+    auto f = std::make_shared<io::AsyncFile>(ring);
+    f->openSync(path, O_RDWR | O_CREAT | O_TRUNC);
+    ASSERT_EQ(f->writeSync("aabbccdd", 8), 8);
+    // submitted before anything polls them
+    std::vector<BoxedFuture<std::unique_ptr<folly::IOBuf>>> reads;
+    for (int i = 0; i < 4; ++i)
+        reads.push_back(f->pread(i * 2, 2));
+    EXPECT_EQ(ring->inflight(), 4u);
+    std::string data;
+    for (auto &r : reads) {
+        ev.spawn(std::move(r)
+            >> [&data] (std::unique_ptr<folly::IOBuf> buf) {
+                data += buf->coalesce().toString();
+                return makeOk();
+            });
+    }
+    ev.run();
+    EXPECT_EQ(data, "aabbccdd");
+    EXPECT_EQ(ring->inflight(), 0u);
+    f->closeSync();
+    ::unlink(path.c_str());
+}
+
+TEST(File, Positional) {
+    EventExecutor ev;
+    auto path = "/tmp/futures_pread_" + std::to_string(getpid());
+    for (auto ring : {io::FileRing::Ptr(), io::FileRing::create(&ev)}) {
+        auto f = std::make_shared<io::AsyncFile>(ring);
+        f->openSync(path, O_RDWR | O_CREAT | O_TRUNC);
+        // a chain is written as a whole
+        auto chain = folly::IOBuf::copyBuffer("0123");
+        chain->prependChain(folly::IOBuf::copyBuffer("4567"));
+        std::vector<std::string> parts(4);
+        std::string vec;
+        ev.spawn(f->pwrite(2, std::move(chain))
+            >> [&, f] (ssize_t n) {
+                EXPECT_EQ(n, 8);
+                // all in flight at once
+                for (size_t i = 0; i < parts.size(); ++i) {
+                    ev.spawn(f->pread(2 + i * 2, 2)
+                        >> [&parts, i] (std::unique_ptr<folly::IOBuf> buf) {
+                            parts[i] = buf->coalesce().toString();
+                            return makeOk();
+                        });
+                }
+                auto bufs = folly::IOBuf::create(3);
+                bufs->prependChain(folly::IOBuf::create(16));
+                return f->preadv(2, std::move(bufs));
+            }
+            >> [&vec] (std::unique_ptr<folly::IOBuf> buf) {
+                EXPECT_EQ(buf->length(), 3u);
+                vec = buf->coalesce().toString();
+                return makeOk();
+            });
+        ev.run();
+        EXPECT_EQ(parts, (std::vector<std::string>{"01", "23", "45", "67"}));
+        EXPECT_EQ(vec, "01234567");
+        f->closeSync();
+    }
+    ::unlink(path.c_str());
+}
+
+TEST(File, LongChain) {
+    EventExecutor ev;
+    auto path = "/tmp/futures_chain_" + std::to_string(getpid());
+    const size_t kBufs = IOV_MAX * 2 + 10;
+    std::string expect;
+    for (size_t i = 0; i < kBufs; ++i)
+        expect += std::string(1 + i % 7, 'a' + i % 26);
+    for (auto ring : {io::FileRing::Ptr(), io::FileRing::create(&ev)}) {
+        auto f = std::make_shared<io::AsyncFile>(ring);
+        f->openSync(path, O_RDWR | O_CREAT | O_TRUNC);
+        // more buffers than a single writev/preadv takes
+        std::unique_ptr<folly::IOBuf> chain;
+        for (size_t i = 0, pos = 0; i < kBufs; pos += 1 + i % 7, ++i) {
+            auto b = folly::IOBuf::copyBuffer(expect.substr(pos, 1 + i % 7));
+            if (chain)
+                chain->prependChain(std::move(b));
+            else
+                chain = std::move(b);
+        }
+        auto tail = folly::IOBuf::copyBuffer("tail");
+        std::string got;
+        ev.spawn(f->write(chain->clone())
+            >> [&, f] (ssize_t n) {
+                EXPECT_EQ(n, (ssize_t)expect.size());
+                // sequential writes continue after the whole chain
+                return f->write(std::move(tail));
+            }
+            >> [&, f] (ssize_t n) {
+                EXPECT_EQ(n, 4);
+                return f->pwrite(expect.size() + 4, std::move(chain));
+            }
+            >> [&, f] (ssize_t n) {
+                EXPECT_EQ(n, (ssize_t)expect.size());
+                std::unique_ptr<folly::IOBuf> bufs;
+                for (size_t i = 0; i < kBufs * 3; ++i) {
+                    auto b = folly::IOBuf::create(4);
+                    if (bufs)
+                        bufs->prependChain(std::move(b));
+                    else
+                        bufs = std::move(b);
+                }
+                return f->preadv(0, std::move(bufs));
+            }
+            >> [&] (std::unique_ptr<folly::IOBuf> buf) {
+                got = buf->coalesce().toString();
+                return makeOk();
+            });
+        ev.run();
+        EXPECT_EQ(got, expect + "tail" + expect);
+        f->closeSync();
+    }
+    ::unlink(path.c_str());
+}
+
+TEST(File, ReadStream) {
+    EventExecutor ev;
+    auto path = "/tmp/futures_stream_" + std::to_string(getpid());
+    std::string content;
+    for (int i = 0; content.size() < 100000; ++i)
+        content += std::to_string(i) + ",";
+    for (auto ring : {io::FileRing::Ptr(), io::FileRing::create(&ev)}) {
+        auto f = std::make_shared<io::AsyncFile>(ring);
+        f->openSync(path, O_RDWR | O_CREAT | O_TRUNC);
+        f->writeSync(content.data(), content.size());
+        std::string data;
+        size_t chunks = 0;
+        ev.spawn(f->readStream(4096, 3, 10)
+            .forEach([&] (std::unique_ptr<folly::IOBuf> buf) {
+                data += buf->coalesce().toString();
+                chunks++;
+            }));
+        // runs right after the stream's first poll, before the ring
+        // submits anything
+        size_t inflight = 0;
+        ev.spawn(makeLazy([&inflight, ring] () {
+            if (ring)
+                inflight = ring->inflight();
+            return unit;
+        }));
+        ev.run();
+        EXPECT_EQ(data, content.substr(10));
+        EXPECT_EQ(chunks, (content.size() - 10 + 4095) / 4096);
+        if (ring)
+            EXPECT_EQ(inflight, 3u);
+        f->closeSync();
+    }
+    ::unlink(path.c_str());
+}
+
+TEST(File, Mapped) {
+    auto path = "/tmp/futures_mapped_" + std::to_string(getpid());
+    std::string content;
+    for (int i = 0; content.size() < 100000; ++i)
+        content += std::to_string(i) + ",";
+    auto f = std::make_shared<io::AsyncFile>();
+    f->openSync(path, O_RDWR | O_CREAT | O_TRUNC);
+    f->writeSync(content.data(), content.size());
+
+    std::unique_ptr<folly::IOBuf> buf;
+    {
+        // unaligned offset, mapping outlives the MappedFile and the fd
+        auto m = io::MappedFile::map(f->fd(), 5000, -1, true);
+        EXPECT_EQ(m->size(), content.size() - 5000);
+        m->advise(MADV_SEQUENTIAL);
+        buf = m->buffer(10, 100);
+        buf->prependChain(m->buffer(m->size() - 10));
+        EXPECT_EQ(m->buffer(m->size() + 1)->length(), 0);
+        // nothing mapped past the end of file
+        auto empty = io::MappedFile::map(f->fd(), content.size());
+        EXPECT_EQ(empty->size(), 0);
+        EXPECT_EQ(empty->data(), nullptr);
+    }
+    f->closeSync();
+    EXPECT_EQ(buf->computeChainDataLength(), 110);
+    auto clone = buf->clone();
+    buf.reset();
+    // read-only pages, never written in place
+    EXPECT_TRUE(clone->isShared());
+    EXPECT_TRUE(clone->isSharedOne());
+    EXPECT_EQ(clone->coalesce().toString(), content.substr(5010, 100)
+            + content.substr(content.size() - 10));
+    ::unlink(path.c_str());
+}
+
+TEST(File, AppendLog) {
+    EventExecutor ev;
+    auto path = "/tmp/futures_journal_" + std::to_string(getpid());
+    auto f = std::make_shared<io::AsyncFile>();
+    f->openSync(path, O_RDWR | O_CREAT | O_TRUNC);
+    f->writeSync("head", 4);
+    io::AppendLog::Options opts;
+    opts.max_latency = 0.005;
+    opts.max_records = 16;
+    auto log = std::make_shared<io::AppendLog>(&ev, f, opts);
+
+    std::string expected = "head";
+    std::vector<off_t> offsets(100, -1);
+    for (int i = 0; i < 100; ++i) {
+        auto rec = std::to_string(i) + ";";
+        ev.spawn(log->append(folly::IOBuf::copyBuffer(rec))
+            | [&offsets, i] (off_t off) { offsets[i] = off; return unit; });
+        expected += rec;
+    }
+    ev.run();
+    off_t off = 4;
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(offsets[i], off);
+        off += std::to_string(i).size() + 1;
+    }
+    EXPECT_EQ(log->getDurableOffset(), expected.size());
+    EXPECT_EQ(log->getPending(), 0);
+    // batched up to max_records
+    EXPECT_LE(log->getCommits(), 8);
+    EXPECT_GE(log->getCommits(), 7);
+    std::string data(expected.size(), '\0');
+    EXPECT_EQ(f->preadSync(&data[0], data.size(), 0), expected.size());
+    EXPECT_EQ(data, expected);
+    ::unlink(path.c_str());
+}
@@ -1,12 +1,25 @@
 #include <gtest/gtest.h>
 #include <futures/Stream.h>
 #include <futures/Timer.h>
+#include <futures/Timeout.h>
 #include <futures/TcpStream.h>
 #include <futures/http/HttpCodec.h>
+#include <futures/http/HttpClient.h>
 #include <futures/service/RpcFuture.h>
 #include <futures/CpuPoolExecutor.h>
 #include <futures/io/AsyncSocket.h>
 #include <futures/io/AsyncServerSocket.h>
+#include <futures/EpollReactor.h>
+#include <futures/io/PipeChannel.h>
+#include <futures/io/AsyncUdpSocket.h>
+#include <futures/io/HappyEyeballs.h>
+#include <futures/io/Proxy.h>
+#include <futures/service/ConnectionPool.h>
+#include <futures/codec/StringEncoder.h>
+#include <futures/codec/LineBasedDecoder.h>
+#include <futures/detail/LoopFn.h>
+#include <netinet/tcp.h>
+#include <thread>
 
 using namespace futures;
 
@@ -162,3 +175,1013 @@ TEST(StreamIO, Accept) {
     ev.run();
 }
 
+
+TEST(StreamIO, AcceptDualStack) {
+    EventExecutor ev;
+    io::ServerSocketOptions opts;
+    opts.backlog = 8;
+    opts.max_accepts = 1;
+    io::AsyncServerSocket::Ptr server;
+    try {
+        server = std::make_shared<io::AsyncServerSocket>(&ev,
+                folly::SocketAddress("::", 0), opts);
+    } catch (IOError &e) {
+        std::cerr << "no IPv6: " << e.what() << std::endl;
+        return;
+    }
+    folly::SocketAddress addr("127.0.0.1", server->getLocalAddress().getPort());
+
+    std::vector<folly::SocketAddress> peers;
+    ev.spawn(server->accept().take(3)
+        .forEach2([&peers] (tcp::Socket sock, folly::SocketAddress peer) {
+            peers.push_back(peer);
+        }));
+    std::vector<io::SocketChannel::Ptr> clients;
+    for (int i = 0; i < 3; ++i) {
+        ev.spawn(io::SocketChannel::connect(&ev, addr)
+            .andThen([&clients] (io::SocketChannel::Ptr sock) {
+                clients.push_back(sock);
+                return makeOk();
+            }));
+    }
+    ev.run();
+    ASSERT_EQ(peers.size(), 3u);
+    // IPv4 clients show up as mapped addresses on a dual-stack listener
+    for (auto &p : peers)
+        EXPECT_EQ(folly::IPAddress::createIPv4(p.getIPAddress()).str(), "127.0.0.1");
+}
+
+TEST(StreamIO, SocketOptions) {
+    EventExecutor ev;
+    io::ServerSocketOptions sopts;
+    sopts.accepted.keep_alive = true;
+    sopts.accepted.keep_idle = 30;
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0), sopts);
+    auto addr = server->getLocalAddress();
+
+    auto getInt = [] (int fd, int level, int name) {
+        int v = 0;
+        socklen_t len = sizeof(v);
+        ::getsockopt(fd, level, name, &v, &len);
+        return v;
+    };
+    int accepted_keepalive = 0;
+    ev.spawn(server->accept().take(1)
+        .forEach2([&] (tcp::Socket sock, folly::SocketAddress peer) {
+            accepted_keepalive = getInt(sock.fd(), SOL_SOCKET, SO_KEEPALIVE);
+        }));
+
+    tcp::SocketOptions copts;
+    copts.no_delay = true;
+    copts.user_timeout = 5000;
+    tcp::TcpInfo info;
+    int nodelay = 0;
+    ev.spawn(io::SocketChannel::connect(&ev, addr, copts)
+        .andThen([&] (io::SocketChannel::Ptr sock) {
+            info = sock->getTcpInfo();
+            nodelay = getInt(sock->fd(), IPPROTO_TCP, TCP_NODELAY);
+            return makeOk();
+        }));
+    ev.run();
+    EXPECT_EQ(accepted_keepalive, 1);
+    EXPECT_EQ(nodelay, 1);
+    EXPECT_EQ(info.state, TCP_ESTABLISHED);
+    EXPECT_GT(info.snd_cwnd, 0u);
+}
+
+TEST(StreamIO, UnixSocket) {
+    auto path = "/tmp/futures_test_" + std::to_string(getpid()) + ".sock";
+    folly::SocketAddress file_addr;
+    file_addr.setFromPath(path);
+    folly::SocketAddress abstract_addr;
+    abstract_addr.setFromPath(std::string("\0futures_test_", 14) + std::to_string(getpid()));
+
+    EventExecutor ev;
+    // the socket file of a closed listener is reused
+    std::make_shared<io::AsyncServerSocket>(&ev, file_addr);
+    for (auto &addr : {file_addr, abstract_addr}) {
+        auto server = std::make_shared<io::AsyncServerSocket>(&ev, addr);
+        std::string data;
+        ev.spawn(server->accept().take(1)
+            .forEach2([&data] (tcp::Socket sock, folly::SocketAddress peer) {
+                auto ev = EventExecutor::current();
+                auto s = std::make_shared<io::SocketChannel>(ev, std::move(sock), peer);
+                ev->spawn(s->readStream()
+                    .forEach([&data, s] (std::unique_ptr<folly::IOBuf> buf) {
+                        data += buf->coalesce().toString();
+                    }));
+            }));
+        ev.spawn(io::SocketChannel::connect(&ev, addr)
+            >> [] (io::SocketChannel::Ptr sock) {
+                return sock->write(folly::IOBuf::copyBuffer("hello"))
+                    >> [sock] (ssize_t n) {
+                        sock->shutdownWrite();
+                        return makeOk();
+                    };
+            });
+        ev.run();
+        EXPECT_EQ(data, "hello");
+    }
+    ::unlink(path.c_str());
+}
+
+TEST(StreamIO, ListenerHandoff) {
+    EventExecutor ev;
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    auto from = std::make_shared<io::SocketChannel>(&ev, tcp::Socket(fds[0]));
+    auto to = std::make_shared<io::SocketChannel>(&ev, tcp::Socket(fds[1]));
+    to->setReceiveFds(true);
+
+    auto old_server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    auto addr = old_server->getLocalAddress();
+    // connects before the handoff and waits in the backlog
+    io::SocketChannel::Ptr client;
+    ev.spawn(io::SocketChannel::connect(&ev, addr)
+        .andThen([&client] (io::SocketChannel::Ptr sock) {
+            client = sock;
+            return makeOk();
+        }));
+    ev.spawn(from->writeWithFds(folly::IOBuf::copyBuffer("L"), {old_server->fd()})
+        .andThen([from] (ssize_t n) {
+            from->shutdownWrite();
+            return makeOk();
+        }));
+
+    int accepted = 0;
+    ev.spawn(to->readStream()
+        .forEach([&] (std::unique_ptr<folly::IOBuf> buf) {
+            auto fds = to->takeReceivedFds();
+            ASSERT_EQ(fds.size(), 1u);
+            old_server.reset();
+            auto server = std::make_shared<io::AsyncServerSocket>(
+                EventExecutor::current(), tcp::Socket(fds[0]));
+            EXPECT_EQ(server->getLocalAddress(), addr);
+            EventExecutor::current()->spawn(server->accept().take(1)
+                .forEach2([&accepted] (tcp::Socket sock, folly::SocketAddress peer) {
+                    accepted++;
+                }));
+        }));
+    ev.run();
+    EXPECT_EQ(accepted, 1);
+}
+
+TEST(StreamIO, EpollReactor) {
+    EventExecutor ev;
+    auto reactor = new EpollReactor(&ev);
+    ev.setReactor(std::unique_ptr<Reactor>(reactor));
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    // larger than the socket buffers, so both sides see EAGAIN and have
+    // to wait for the next edge
+    const size_t total = 8 << 20;
+    size_t received = 0;
+    ev.spawn(server->accept().take(1)
+        .forEach2([&received] (tcp::Socket sock, folly::SocketAddress peer) {
+            auto ev = EventExecutor::current();
+            auto s = std::make_shared<io::SocketChannel>(ev, std::move(sock), peer);
+            ev->spawn(s->readStream()
+                .forEach([&received, s] (std::unique_ptr<folly::IOBuf> buf) {
+                    received += buf->computeChainDataLength();
+                }));
+        }));
+    ev.spawn(io::SocketChannel::connect(&ev, server->getLocalAddress())
+        >> [total] (io::SocketChannel::Ptr sock) {
+            std::string data(total, 'x');
+            return sock->write(folly::IOBuf::copyBuffer(data))
+                >> [sock] (ssize_t n) {
+                    sock->shutdownWrite();
+                    return makeOk();
+                };
+        });
+    ev.run();
+    EXPECT_EQ(received, total);
+    EXPECT_GT(reactor->getEvents(), 0u);
+}
+
+TEST(StreamIO, EpollReactorFdReuse) {
+    EventExecutor ev;
+    ev.setReactor(std::unique_ptr<Reactor>(new EpollReactor(&ev)));
+    auto first = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    int fd = first->fd();
+    first->forceClose();
+    // the new listener gets the closed fd number and must be registered
+    // with epoll again
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    EXPECT_EQ(server->fd(), fd);
+    int accepted = 0;
+    ev.spawn(server->accept().take(1)
+        .forEach2([&accepted] (tcp::Socket sock, folly::SocketAddress peer) {
+            accepted++;
+        }));
+    ev.spawn(io::SocketChannel::connect(&ev, server->getLocalAddress())
+        >> [] (io::SocketChannel::Ptr sock) {
+            return makeOk();
+        });
+    ev.spawn(delay(&ev, 0.5)
+        >> [&ev] (Unit) {
+            // don't hang if the accept never fires
+            ev.stop();
+            return makeOk();
+        });
+    ev.run();
+    EXPECT_EQ(accepted, 1);
+}
+
+TEST(StreamIO, SendFile) {
+    EventExecutor ev;
+    auto path = "/tmp/futures_sendfile_" + std::to_string(getpid());
+    std::string content;
+    for (int i = 0; content.size() < (3 << 20); ++i)
+        content += std::to_string(i) + ",";
+    auto file = std::make_shared<io::AsyncFile>();
+    file->openSync(path, O_RDWR | O_CREAT | O_TRUNC);
+    file->writeSync(content.data(), content.size());
+    // not a regular file, read and written in chunks
+    auto zero = std::make_shared<io::AsyncFile>();
+    zero->openSync("/dev/zero", O_RDONLY);
+
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    std::string data;
+    ev.spawn(server->accept().take(1)
+        .forEach2([&data] (tcp::Socket sock, folly::SocketAddress peer) {
+            auto ev = EventExecutor::current();
+            auto s = std::make_shared<io::SocketChannel>(ev, std::move(sock), peer);
+            ev->spawn(s->readStream()
+                .forEach([&data, s] (std::unique_ptr<folly::IOBuf> buf) {
+                    data += buf->coalesce().toString();
+                }));
+        }));
+    std::vector<ssize_t> sent;
+    ev.spawn(io::SocketChannel::connect(&ev, server->getLocalAddress())
+        >> [&] (io::SocketChannel::Ptr sock) {
+            // queued in order with the surrounding writes
+            ev.spawn(sock->write(folly::IOBuf::copyBuffer("<"))
+                | [] (ssize_t) { return unit; });
+            ev.spawn(sock->sendFile(file, 10, content.size())
+                | [&sent] (ssize_t n) { sent.push_back(n); return unit; });
+            ev.spawn(sock->write(folly::IOBuf::copyBuffer(">"))
+                | [] (ssize_t) { return unit; });
+            ev.spawn(sock->sendFile(zero, 0, 100000)
+                >> [&sent, sock] (ssize_t n) {
+                    sent.push_back(n);
+                    sock->shutdownWrite();
+                    return makeOk();
+                });
+            return makeOk();
+        });
+    ev.run();
+    EXPECT_EQ(sent, (std::vector<ssize_t>{ssize_t(content.size() - 10), 100000}));
+    EXPECT_EQ(data, "<" + content.substr(10) + ">" + std::string(100000, '\0'));
+    ::unlink(path.c_str());
+}
+
+TEST(StreamIO, Timeouts) {
+    EventExecutor ev;
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    // accepted but never read from or written to
+    std::vector<tcp::Socket> accepted;
+    ev.spawn(server->accept().take(1)
+        .forEach2([&accepted] (tcp::Socket sock, folly::SocketAddress peer) {
+            accepted.push_back(std::move(sock));
+        }));
+    std::vector<std::string> errors;
+    std::vector<double> elapsed;
+    double start = ev.getNow();
+    auto failed = [&] (Try<Unit> r) {
+        EXPECT_TRUE(r.hasException());
+        errors.push_back(r.exception().what());
+        elapsed.push_back(ev.getNow() - start);
+    };
+    ev.spawn(io::SocketChannel::connect(&ev, server->getLocalAddress())
+        >> [&] (io::SocketChannel::Ptr sock) {
+            sock->setReadTimeout(0.1);
+            return sock->readStream()
+                .forEach([] (std::unique_ptr<folly::IOBuf> buf) {})
+                .then([&, sock] (Try<Unit> r) {
+                    failed(std::move(r));
+                    // only the read failed
+                    EXPECT_TRUE(sock->good());
+                    sock->setReadTimeout(0);
+                    sock->setIdleTimeout(0.1);
+                    return sock->readStream()
+                        .forEach([] (std::unique_ptr<folly::IOBuf> buf) {})
+                        .then([&, sock] (Try<Unit> r) {
+                            failed(std::move(r));
+                            EXPECT_FALSE(sock->good());
+                            return makeOk();
+                        }).boxed();
+                });
+        });
+    ev.run();
+    ASSERT_EQ(errors.size(), 2);
+    auto timedOut = std::make_error_code(std::errc::timed_out).message();
+    EXPECT_NE(errors[0].find(timedOut), std::string::npos) << errors[0];
+    EXPECT_NE(errors[1].find(timedOut), std::string::npos) << errors[1];
+    EXPECT_GE(elapsed[0], 0.09);
+    EXPECT_GE(elapsed[1], elapsed[0] + 0.09);
+    EXPECT_LT(elapsed[1], 1.0);
+    EXPECT_EQ(ev.getDeadlines().size(), 0);
+}
+
+TEST(StreamIO, WriteWatermarks) {
+    EventExecutor ev;
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    // the peer doesn't read until later
+    io::SocketChannel::Ptr peer;
+    ev.spawn(server->accept().take(1)
+        .forEach2([&peer] (tcp::Socket sock, folly::SocketAddress addr) {
+            peer = std::make_shared<io::SocketChannel>(EventExecutor::current(),
+                    std::move(sock), addr);
+        }));
+    const size_t chunk = 64 * 1024, total = 32 << 20;
+    const size_t low = 128 * 1024, high = 512 * 1024;
+    size_t sent = 0, max_buffered = 0, stalled_at = 0, received = 0;
+    ev.spawn(io::SocketChannel::connect(&ev, server->getLocalAddress())
+        >> [&] (io::SocketChannel::Ptr sock) {
+            sock->setWriteWatermarks(low, high);
+            auto sink = std::make_shared<io::FramedSink<std::string>>(sock,
+                    std::make_shared<codec::StringEncoder>());
+            return makeLoop(size_t(0), [&, sock, sink] (size_t n) {
+                return sink->ready()
+                    >> [&, sock, sink] (Unit) {
+                        max_buffered = std::max(max_buffered,
+                                sock->getWriteBuffered());
+                        sink->startSend(std::string(chunk, 'x'));
+                        sent += chunk;
+                        if (sent < total)
+                            return makeOk(makeContinue<Unit, size_t>(0)).boxed();
+                        return (sink->flush()
+                            | [sock] (Unit) {
+                                sock->shutdownWrite();
+                                return makeBreak<Unit, size_t>(unit);
+                            }).boxed();
+                    };
+            });
+        });
+    ev.spawn(delay(&ev, 0.2)
+        >> [&] (Unit) {
+            stalled_at = sent;
+            return peer->readStream()
+                .forEach([&] (std::unique_ptr<folly::IOBuf> buf) {
+                    received += buf->computeChainDataLength();
+                });
+        });
+    ev.run();
+    EXPECT_LT(stalled_at, total);
+    EXPECT_LE(max_buffered, high + chunk);
+    EXPECT_EQ(sent, total);
+    EXPECT_EQ(received, total);
+}
+
+TEST(StreamIO, HappyEyeballs) {
+    auto order = io::HappyEyeballsFuture::interleave({
+            folly::IPAddress("10.0.0.1"), folly::IPAddress("10.0.0.2"),
+            folly::IPAddress("::2"), folly::IPAddress("10.0.0.3")});
+    EXPECT_EQ(order, (dns::ResolverResult{folly::IPAddress("::2"),
+                folly::IPAddress("10.0.0.1"), folly::IPAddress("10.0.0.2"),
+                folly::IPAddress("10.0.0.3")}));
+
+    EventExecutor ev;
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    ev.spawn(server->accept().take(1)
+        .forEach2([] (tcp::Socket sock, folly::SocketAddress peer) {}));
+    // the first address never answers, its attempt is dropped once the
+    // second one connects
+    std::vector<std::string> attempts;
+    auto connector = [&] (const folly::SocketAddress &addr) {
+        attempts.push_back(addr.getAddressStr());
+        if (addr.getAddressStr() == "10.0.0.1")
+            return (delay(&ev, 5.0)
+                >> [] (Unit) {
+                    return makeErr<io::SocketChannel::Ptr>(IOError("unreachable"));
+                }).boxed();
+        return io::SocketChannel::connect(&ev, addr).boxed();
+    };
+    double start = ev.getNow(), connected = 0;
+    uint16_t port = server->getLocalAddress().getPort();
+    ev.spawn(io::connectHappyEyeballs(&ev, {folly::IPAddress("10.0.0.1"),
+                folly::IPAddress("127.0.0.1")}, port, connector)
+        >> [&] (io::SocketChannel::Ptr sock) {
+            EXPECT_EQ(sock->getPeerAddress().getAddressStr(), "127.0.0.1");
+            connected = ev.getNow() - start;
+            return makeOk();
+        });
+    ev.run();
+    EXPECT_EQ(attempts, (std::vector<std::string>{"10.0.0.1", "127.0.0.1"}));
+    EXPECT_GE(connected, io::HappyEyeballsFuture::kAttemptDelay - 0.01);
+    EXPECT_LT(ev.getNow() - start, 2.0);
+
+    // every attempt refused, fails with the last error without waiting
+    bool failed = false;
+    server.reset();
+    ev.spawn(io::connectHappyEyeballs(&ev, {folly::IPAddress("127.0.0.1"),
+                folly::IPAddress("127.0.0.1")}, port)
+        .then([&] (Try<io::SocketChannel::Ptr> r) {
+            failed = r.hasException();
+            return makeOk();
+        }));
+    start = ev.getNow();
+    ev.run();
+    EXPECT_TRUE(failed);
+    EXPECT_LT(ev.getNow() - start, io::HappyEyeballsFuture::kAttemptDelay);
+}
+
+TEST(StreamIO, ConnectionPool) {
+    EventExecutor ev;
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    auto addr = server->getLocalAddress();
+    std::vector<io::SocketChannel::Ptr> accepted;
+    auto accept = [&] (size_t n) {
+        ev.spawn(server->accept().take(n)
+            .forEach2([&accepted] (tcp::Socket sock, folly::SocketAddress peer) {
+                accepted.push_back(std::make_shared<io::SocketChannel>(
+                            EventExecutor::current(), std::move(sock), peer));
+            }));
+    };
+    accept(2);
+
+    using Pool = service::ConnectionPool<io::SocketChannel>;
+    Pool::Options opts;
+    opts.max_per_key = 2;
+    opts.idle_timeout = 0.2;
+    auto pool = std::make_shared<Pool>(&ev,
+        [&ev] (const folly::SocketAddress &addr) {
+            return io::SocketChannel::connect(&ev, addr).boxed();
+        }, opts, [] (io::SocketChannel &c) { return c.good(); });
+    size_t closed = 0;
+    pool->setCloser([&closed] (io::SocketChannel::Ptr c) {
+        closed++;
+    });
+    pool->prewarm(addr, 1);
+
+    // more callers than connections, the rest wait for a lease to return
+    size_t done = 0, leased = 0, max_leased = 0;
+    for (int i = 0; i < 5; ++i) {
+        ev.spawn(pool->checkout(addr)
+            >> [&] (Pool::Lease lease) {
+                EXPECT_TRUE(lease->good());
+                max_leased = std::max(max_leased, ++leased);
+                auto l = std::make_shared<Pool::Lease>(std::move(lease));
+                return delay(&ev, 0.02)
+                    >> [&, l] (Unit) {
+                        leased--;
+                        done++;
+                        l->release();
+                        return makeOk();
+                    };
+            });
+    }
+    ev.run();
+    EXPECT_EQ(done, 5);
+    EXPECT_EQ(max_leased, 2);
+    EXPECT_EQ(pool->getConnects(), 2);
+    EXPECT_EQ(pool->getIdleCount(addr), 2);
+    EXPECT_EQ(pool->getLeasedCount(addr), 0);
+
+    // a discarded lease is not reused, idle ones are reaped
+    ev.spawn(pool->checkout(addr)
+        >> [&] (Pool::Lease lease) {
+            lease.discard();
+            return delay(&ev, 0.3);
+        });
+    ev.run();
+    EXPECT_EQ(pool->getCount(addr), 0);
+    EXPECT_EQ(closed, 2);
+
+    // returned connections beyond max_idle_per_key are closed
+    opts.max_idle_per_key = 1;
+    auto small = std::make_shared<Pool>(&ev,
+        [&ev] (const folly::SocketAddress &addr) {
+            return io::SocketChannel::connect(&ev, addr).boxed();
+        }, opts);
+    small->setCloser([&closed] (io::SocketChannel::Ptr c) {
+        closed++;
+    });
+    accept(2);
+    ev.spawn(small->checkout(addr).join(small->checkout(addr))
+        >> [&] (std::tuple<Pool::Lease, Pool::Lease> leases) {
+            EXPECT_EQ(small->getLeasedCount(addr), 2);
+            return makeOk();
+        });
+    ev.run();
+    EXPECT_EQ(small->getIdleCount(addr), 1);
+    EXPECT_EQ(closed, 3);
+}
+
+TEST(StreamIO, ConnectionPoolTimeout) {
+    EventExecutor ev;
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    auto addr = server->getLocalAddress();
+    std::vector<io::SocketChannel::Ptr> accepted;
+    ev.spawn(server->accept().take(1)
+        .forEach2([&] (tcp::Socket sock, folly::SocketAddress peer) {
+            accepted.push_back(std::make_shared<io::SocketChannel>(
+                        &ev, std::move(sock), peer));
+        }));
+
+    using Pool = service::ConnectionPool<io::SocketChannel>;
+    // slow enough for the first checkout to give up
+    auto pool = std::make_shared<Pool>(&ev,
+        [&ev] (const folly::SocketAddress &addr) {
+            return (delay(&ev, 0.05)
+                >> [&ev, addr] (Unit) {
+                    return io::SocketChannel::connect(&ev, addr);
+                }).boxed();
+        });
+
+    bool timed_out = false, leased = false;
+    ev.spawn(timeout(&ev, pool->checkout(addr), 0.01)
+        .then([&] (Try<Pool::Lease> r) {
+            timed_out = r.hasException();
+            // the abandoned checkout neither waits nor connects
+            return (pool->checkout(addr)
+                >> [&] (Pool::Lease lease) {
+                    leased = true;
+                    return makeOk();
+                }).boxed();
+        }));
+    ev.run();
+    EXPECT_TRUE(timed_out);
+    EXPECT_TRUE(leased);
+    EXPECT_EQ(pool->getConnects(), 1);
+    EXPECT_EQ(pool->getIdleCount(addr), 1);
+}
+
+TEST(StreamIO, HttpClientPool) {
+    struct Hello : public service::Service<http::Request, http::Response> {
+        BoxedFuture<http::Response> operator()(http::Request req) override {
+            http::Response resp;
+            resp.http_errno = 200;
+            resp.body.append("Hello", 5);
+            return makeOk(std::move(resp));
+        }
+    };
+
+    EventExecutor ev;
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    auto service = std::make_shared<Hello>();
+    size_t accepts = 0;
+    ev.spawn(server->accept()
+        .forEach2([&] (tcp::Socket s, folly::SocketAddress peer) {
+            accepts++;
+            auto sock = std::make_shared<io::SocketChannel>(&ev, std::move(s), peer);
+            ev.spawn(service::makePipelineRpcFuture(sock,
+                io::FramedStream<http::Request>(sock, std::make_shared<http::HttpV1RequestDecoder>()),
+                io::FramedSink<http::Response>(sock, std::make_shared<http::HttpV1ResponseEncoder>()),
+                service)
+                .error([] (folly::exception_wrapper w) {}));
+        }));
+
+    auto pool = http::HttpClient::makePool(&ev, nullptr);
+    auto url = http::HttpClient::parseUrl("http://127.0.0.1:"
+            + std::to_string(server->getLocalAddress().getPort()) + "/");
+    auto a = std::make_shared<http::HttpClient>(&ev, pool, url);
+    auto b = std::make_shared<http::HttpClient>(&ev, pool, url);
+
+    // one after the other, both clients share the connection, concurrent
+    // requests take a connection each
+    std::vector<std::string> bodies;
+    auto get = [&bodies] (std::shared_ptr<http::HttpClient> c) {
+        return c->get("/") >> [&bodies] (http::Response resp) {
+            bodies.push_back(resp.body.move()->coalesce().toString());
+            return makeOk();
+        };
+    };
+    auto key = http::HttpClient::poolKey(url);
+    auto last = [&bodies, &ev] (Unit) {
+        if (bodies.size() == 5)
+            ev.stop();
+        return makeOk();
+    };
+    ev.spawn(((get(a) >> [&] (Unit) { return get(b); })
+        >> [&] (Unit) {
+            return get(a);
+        })
+        >> [&] (Unit) {
+            EXPECT_EQ(accepts, 1);
+            EXPECT_EQ(pool->getIdleCount(key), 1);
+            // join() polls one after the other
+            ev.spawn(get(a) >> last);
+            ev.spawn(get(b) >> last);
+            return makeOk();
+        });
+    ev.run();
+    EXPECT_EQ(bodies, std::vector<std::string>(5, "Hello"));
+    EXPECT_EQ(pool->getConnects(), 2);
+    EXPECT_EQ(accepts, 2);
+}
+
+TEST(StreamIO, PipeWrite) {
+    EventExecutor ev;
+    int fds[2];
+    ASSERT_EQ(::pipe2(fds, O_NONBLOCK), 0);
+    auto rd = std::make_shared<io::PipeChannel>(&ev, folly::File(fds[0], true), folly::File());
+    auto wr = std::make_shared<io::PipeChannel>(&ev, folly::File(), folly::File(fds[1], true));
+
+    auto buf = folly::IOBuf::copyBuffer("AAA", 3);
+    buf->prependChain(folly::IOBuf::copyBuffer("BBB", 3));
+    ssize_t written = 0;
+    ev.spawn(wr->write(std::move(buf))
+        .andThen([&written, wr] (ssize_t n) {
+            written = n;
+            wr->shutdownWrite();
+            return makeOk();
+        }));
+
+    std::string data;
+    ev.spawn(rd->readStream()
+        .forEach([&data] (std::unique_ptr<folly::IOBuf> buf) {
+            data += buf->coalesce().toString();
+        }));
+    ev.run();
+    EXPECT_EQ(written, 6);
+    EXPECT_EQ(data, "AAABBB");
+}
+
+TEST(StreamIO, WriteCoalescing) {
+    EventExecutor ev;
+    int fds[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    auto wr = std::make_shared<io::SocketChannel>(&ev, tcp::Socket(fds[0]));
+    auto rd = std::make_shared<io::SocketChannel>(&ev, tcp::Socket(fds[1]));
+
+    // a large write fills the socket buffer, so the rest are queued
+    const size_t kLarge = 4 * 1024 * 1024;
+    std::string expected(kLarge, 'x');
+    ev.spawn(wr->write(folly::IOBuf::copyBuffer(expected))
+        .andThen([] (ssize_t n) { return makeOk(); }));
+    int done = 0;
+    for (int i = 0; i < 100; ++i) {
+        auto s = std::to_string(i) + ",";
+        expected += s;
+        auto f = wr->write(folly::IOBuf::copyBuffer(s))
+            .andThen([&done, wr] (ssize_t n) {
+                if (++done == 100)
+                    wr->shutdownWrite();
+                return makeOk();
+            });
+        ev.spawn(std::move(f));
+    }
+
+    std::string data;
+    ev.spawn(rd->readStream()
+        .forEach([&data] (std::unique_ptr<folly::IOBuf> buf) {
+            data += buf->coalesce().toString();
+        }));
+    ev.run();
+    EXPECT_EQ(done, 100);
+    EXPECT_EQ(data.size(), expected.size());
+    EXPECT_TRUE(data == expected);
+}
+
+TEST(StreamIO, ZeroCopyWrite) {
+    EventExecutor ev;
+    folly::SocketAddress addr("127.0.0.1", 8034);
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev, addr);
+
+    const size_t kSize = 1024 * 1024;
+    size_t received = 0;
+    ev.spawn(server->accept().take(1)
+        .forEach2([&received] (tcp::Socket sock, folly::SocketAddress peer) {
+            auto ev = EventExecutor::current();
+            auto s = std::make_shared<io::SocketChannel>(ev, std::move(sock), peer);
+            ev->spawn(s->readStream()
+                .forEach([&received] (std::unique_ptr<folly::IOBuf> buf) {
+                    received += buf->computeChainDataLength();
+                }));
+        }));
+
+    io::SocketChannel::Ptr client;
+    ssize_t written = 0;
+    ev.spawn(io::SocketChannel::connect(&ev, addr)
+        .andThen([&client, &written, kSize] (io::SocketChannel::Ptr sock) {
+            client = sock;
+            if (!sock->setZeroCopy(true, 4096))
+                FUTURES_LOG(WARNING) << "zero-copy not supported";
+            auto buf = folly::IOBuf::create(kSize);
+            memset(buf->writableData(), 'x', kSize);
+            buf->append(kSize);
+            return sock->write(std::move(buf))
+                .andThen([&written, sock] (ssize_t n) {
+                    written = n;
+                    sock->shutdownWrite();
+                    return makeOk();
+                });
+        }));
+    ev.run();
+    EXPECT_EQ(written, kSize);
+    EXPECT_EQ(received, kSize);
+    std::cerr << "copied: " << client->getCopiedBytes()
+        << ", zerocopy: " << client->getZeroCopiedBytes() << std::endl;
+    EXPECT_EQ(client->getCopiedBytes() + client->getZeroCopiedBytes(), kSize);
+}
+
+TEST(StreamIO, UdpBatch) {
+    EventExecutor ev;
+    auto rx = std::make_shared<io::AsyncUdpSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    auto tx = std::make_shared<io::AsyncUdpSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    rx->setGro(true);
+    // three full segments and a short one may go out as one GSO message
+    tx->setGso(100);
+    auto to = rx->getLocalAddress();
+    auto from = tx->getLocalAddress();
+
+    std::vector<size_t> sizes{100, 100, 100, 40, 7};
+    auto sink = std::make_shared<io::UdpSendSink>(tx->sink());
+    for (auto n : sizes)
+        sink->startSend(std::make_tuple(
+                    folly::IOBuf::copyBuffer(std::string(n, 'a' + n % 26)), to));
+    ev.spawn(sink->flush().andThen([sink] (Unit) { return makeOk(); }));
+
+    std::vector<size_t> got;
+    ev.spawn(rx->recv().take(sizes.size())
+        .forEach([&got, &from] (io::Datagram d) {
+            auto &buf = std::get<0>(d);
+            EXPECT_EQ(std::get<1>(d), from);
+            EXPECT_EQ(buf->length(), std::count(buf->data(),
+                        buf->data() + buf->length(), buf->data()[0]));
+            got.push_back(buf->length());
+        }));
+    ev.run();
+    EXPECT_EQ(got, sizes);
+}
+
+TEST(StreamIO, AdaptiveReadSizer) {
+    io::ReadPolicy policy;
+    policy.min_read = 64;
+    policy.initial_read = 1024;
+    policy.max_read = 16 * 1024;
+    io::AdaptiveReadSizer sizer(policy);
+    EXPECT_EQ(sizer.next(), 1024);
+    // full reads grow quickly up to max_read
+    sizer.record(1024, 1024);
+    EXPECT_EQ(sizer.next(), 4096);
+    sizer.record(4096, 4096);
+    sizer.record(16384, 16384);
+    EXPECT_EQ(sizer.next(), 16384);
+    // shrink only after two small reads in a row
+    sizer.record(16384, 100);
+    EXPECT_EQ(sizer.next(), 16384);
+    sizer.record(16384, 100);
+    EXPECT_EQ(sizer.next(), 8192);
+}
+
+TEST(StreamIO, ScatterRead) {
+    EventExecutor ev;
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    std::string content;
+    for (int i = 0; content.size() < (2 << 20); ++i)
+        content += std::string(1 + i % 300, 'a' + i % 26) + "\n";
+    ev.spawn(server->accept().take(1)
+        .forEach2([&content] (tcp::Socket sock, folly::SocketAddress addr) {
+            auto ev = EventExecutor::current();
+            auto s = std::make_shared<io::SocketChannel>(ev, std::move(sock), addr);
+            ev->spawn(s->write(folly::IOBuf::copyBuffer(content))
+                >> [s] (ssize_t) {
+                    s->shutdownWrite();
+                    return makeOk();
+                });
+        }));
+    // lines are decoded from the segments readv() filled
+    std::string lines;
+    ev.spawn(io::SocketChannel::connect(&ev, server->getLocalAddress())
+        >> [&lines] (io::SocketChannel::Ptr sock) {
+            return io::FramedStream<codec::LineBasedOut>(sock,
+                    std::make_shared<codec::LineBasedDecoder>())
+                .forEach([&lines] (std::unique_ptr<folly::IOBuf> line) {
+                    lines += line->coalesce().toString() + "\n";
+                });
+        });
+    ev.run();
+    EXPECT_EQ(lines, content);
+}
+
+TEST(StreamIO, Proxy) {
+    // plain sockets splice, also on the edge-triggered reactor, a channel
+    // receiving descriptors copies
+    enum { SPLICE, SPLICE_EPOLL, COPY };
+    for (int mode : {SPLICE, SPLICE_EPOLL, COPY}) {
+        EventExecutor ev;
+        if (mode == SPLICE_EPOLL)
+            ev.setReactor(std::unique_ptr<Reactor>(new EpollReactor(&ev)));
+        auto front = std::make_shared<io::AsyncServerSocket>(&ev,
+                folly::SocketAddress("127.0.0.1", 0));
+        auto back = std::make_shared<io::AsyncServerSocket>(&ev,
+                folly::SocketAddress("127.0.0.1", 0));
+        const std::string request(3 << 20, 'q');
+        std::string received, reply;
+        io::ProxyStats stats;
+        // the upstream reads the whole request before it replies
+        ev.spawn(back->accept().take(1)
+            .forEach2([&] (tcp::Socket sock, folly::SocketAddress addr) {
+                auto up = std::make_shared<io::SocketChannel>(&ev,
+                        std::move(sock), addr);
+                ev.spawn(up->readStream()
+                    .forEach([&received] (std::unique_ptr<folly::IOBuf> buf) {
+                        received += buf->coalesce().toString();
+                    })
+                    >> [up] (Unit) {
+                        return up->write(folly::IOBuf::copyBuffer("bye"));
+                    }
+                    >> [up] (ssize_t) {
+                        up->shutdownWrite();
+                        return makeOk();
+                    });
+            }));
+        ev.spawn(front->accept().take(1)
+            .forEach2([&] (tcp::Socket sock, folly::SocketAddress addr) {
+                auto down = std::make_shared<io::SocketChannel>(&ev,
+                        std::move(sock), addr);
+                if (mode == COPY)
+                    down->setReceiveFds(true);
+                ev.spawn(io::SocketChannel::connect(&ev, back->getLocalAddress())
+                    >> [&, down] (io::SocketChannel::Ptr up) {
+                        return io::proxy(&ev, down, up);
+                    }
+                    >> [&stats] (io::ProxyStats s) {
+                        stats = s;
+                        return makeOk();
+                    });
+            }));
+        ev.spawn(io::SocketChannel::connect(&ev, front->getLocalAddress())
+            >> [&] (io::SocketChannel::Ptr client) {
+                ev.spawn(client->write(folly::IOBuf::copyBuffer(request))
+                    >> [client] (ssize_t) {
+                        // half-close, the reply still comes back
+                        client->shutdownWrite();
+                        return makeOk();
+                    });
+                return client->readStream()
+                    .forEach([&reply] (std::unique_ptr<folly::IOBuf> buf) {
+                        reply += buf->coalesce().toString();
+                    });
+            });
+        ev.run();
+        EXPECT_EQ(received, request);
+        EXPECT_EQ(reply, "bye");
+        EXPECT_EQ(stats.forward, request.size());
+        EXPECT_EQ(stats.backward, 3);
+        EXPECT_EQ(stats.spliced, mode != COPY);
+    }
+}
+
+// holds everything read until the whole message arrived
+class WholeMessageDecoder : public codec::DecoderBase<size_t> {
+public:
+    explicit WholeMessageDecoder(size_t size) : size_(size) {}
+
+    Optional<size_t> decode(folly::IOBufQueue &buf) override {
+        if (buf.chainLength() < size_)
+            return none;
+        size_t n = buf.chainLength();
+        buf.move();
+        return n;
+    }
+
+private:
+    size_t size_;
+};
+
+TEST(StreamIO, MemoryBudget) {
+    EventExecutor ev;
+    auto &budget = ev.getMemoryBudget();
+    const size_t low = 256 * 1024, high = 1 << 20, total = 8 << 20;
+    budget.setWatermarks(low, high);
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    std::vector<size_t> received;
+    ev.spawn(server->accept().take(2)
+        .forEach2([&] (tcp::Socket sock, folly::SocketAddress addr) {
+            auto s = std::make_shared<io::SocketChannel>(&ev, std::move(sock), addr);
+            ev.spawn(io::FramedStream<size_t>(s,
+                        std::make_shared<WholeMessageDecoder>(total))
+                .forEach([&received] (size_t n) {
+                    received.push_back(n);
+                }));
+        }));
+    // blocking writers, so only the readers are charged here
+    auto addr = server->getLocalAddress();
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 2; ++i) {
+        writers.emplace_back([addr, total] () {
+            int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_storage sa;
+            socklen_t len = addr.getAddress(&sa);
+            ASSERT_EQ(::connect(fd, (sockaddr*)&sa, len), 0);
+            std::string data(total, 'x');
+            for (size_t off = 0; off < data.size(); ) {
+                ssize_t n = ::send(fd, data.data() + off, data.size() - off, 0);
+                ASSERT_GT(n, 0);
+                off += n;
+            }
+            ::close(fd);
+        });
+    }
+    size_t usage = 0, paused = 0;
+    ev.spawn(delay(&ev, 0.3)
+        >> [&] (Unit) {
+            usage = budget.getUsage();
+            paused = budget.getPausedCount();
+            // lifting the limit resumes both
+            budget.setWatermarks(0, 0);
+            return makeOk();
+        });
+    ev.run();
+    for (auto &t : writers)
+        t.join();
+    EXPECT_EQ(paused, 2);
+    EXPECT_GE(usage, high);
+    // pausing takes effect after the loop iteration, each connection may
+    // have read a full event's worth plus one scatter read by then
+    io::ReadPolicy policy;
+    EXPECT_LT(usage, high + 2 * (policy.max_bytes_per_event + 2 * policy.max_read));
+    EXPECT_EQ(received, (std::vector<size_t>{total, total}));
+    EXPECT_EQ(budget.getUsage(), 0);
+}
+
+TEST(StreamIO, MemoryBudgetGlobal) {
+    struct Account : public MemoryBudget::Account {
+        bool paused = false;
+        void pauseReading() override { paused = true; }
+        void resumeReading() override { paused = false; }
+    };
+    EventExecutor ev, other;
+    Account a, b;
+    MemoryBudget::setGlobalWatermarks(512 * 1024, 1 << 20);
+    // the other executor alone is over the global watermark
+    other.getMemoryBudget().charge(&b, 2 << 20);
+    ev.getMemoryBudget().charge(&a, 1);
+    bool paused = false;
+    ev.spawn(delay(&ev, 0.1)
+        >> [&] (Unit) {
+            paused = a.paused;
+            // no charge on `ev' follows
+            other.getMemoryBudget().charge(&b, -(2 << 20));
+            return delay(&ev, 0.2);
+        });
+    ev.run();
+    EXPECT_TRUE(paused);
+    EXPECT_FALSE(a.paused);
+    EXPECT_EQ(ev.getMemoryBudget().getPausedCount(), 0);
+    ev.getMemoryBudget().charge(&a, -1);
+    MemoryBudget::setGlobalWatermarks(0, 0);
+}
+
+TEST(StreamIO, MemoryBudgetEof) {
+    EventExecutor ev;
+    auto &budget = ev.getMemoryBudget();
+    auto server = std::make_shared<io::AsyncServerSocket>(&ev,
+            folly::SocketAddress("127.0.0.1", 0));
+    ev.spawn(server->accept().take(1)
+        .forEach2([] (tcp::Socket sock, folly::SocketAddress addr) {
+            auto ev = EventExecutor::current();
+            auto s = std::make_shared<io::SocketChannel>(ev, std::move(sock), addr);
+            std::string lines;
+            for (int i = 0; i < 10; ++i)
+                lines += std::string(99, 'a' + i) + "\n";
+            ev->spawn(s->write(folly::IOBuf::copyBuffer(lines))
+                >> [s] (ssize_t) {
+                    s->shutdownWrite();
+                    return makeOk();
+                });
+        }));
+    // EOF is read while the consumer is busy with the first line, the
+    // lines not decoded yet stay charged
+    std::vector<size_t> usage;
+    ev.spawn(io::SocketChannel::connect(&ev, server->getLocalAddress())
+        >> [&] (io::SocketChannel::Ptr sock) {
+            return delay(&ev, 0.1)
+                >> [&, sock] (Unit) {
+                    return io::FramedStream<codec::LineBasedOut>(sock,
+                            std::make_shared<codec::LineBasedDecoder>())
+                        .andThen([&] (std::unique_ptr<folly::IOBuf> line) {
+                            return delay(&ev, 0.01)
+                                >> [&] (Unit) {
+                                    return makeOk(budget.getUsage());
+                                };
+                        })
+                        .forEach([&] (size_t n) {
+                            usage.push_back(n);
+                        });
+                };
+        });
+    ev.run();
+    EXPECT_EQ(usage, (std::vector<size_t>{900, 800, 700, 600, 500, 400, 300,
+                200, 100, 0}));
+    EXPECT_EQ(budget.getUsage(), 0);
+}